@@ -0,0 +1,123 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Fixture shared by benchmarks, so that each of them has only its own workload and checks
+ */
+
+#ifndef EMYZELIUM_BENCH_HPP
+#define EMYZELIUM_BENCH_HPP
+
+#include "../emyzelium.hpp"
+
+#include <chrono>
+#include <functional>
+#include <poll.h>
+#include <unistd.h>
+
+
+inline int64_t time_musec() {
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+inline int64_t time_nsec() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Same clock as t_out and t_in of etales
+inline int64_t wall_time_musec() {
+	return chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+
+// Of new keypair
+inline string new_secretkey(string& publickey) {
+	char pk[41];
+	char sk[41];
+	zmq_curve_keypair(pk, sk);
+	publickey = pk;
+	return sk;
+}
+
+
+// Unique per benchmark and process
+inline string bench_endpoint(const string& name) {
+	return "ipc:///tmp/emyzelium-bench-" + name + "-" + to_string(getpid());
+}
+
+
+// Publisher bound to endpoint of benchmark, and subscriber with ehypha of it
+struct PubSub {
+	string endpoint;
+	string pub_publickey;
+	string sub_publickey;
+	Emyzelium::Efunguz pub;
+	Emyzelium::Efunguz sub;
+	Emyzelium::Ehypha& ehypha;
+	vector<pollfd> sub_items;
+
+	PubSub(const string& name)
+	: endpoint {bench_endpoint(name)}, pub {new_secretkey(pub_publickey), {}, vector<string>{endpoint}}, sub {new_secretkey(sub_publickey), {}, vector<string>{}},
+	ehypha {*get<0>(sub.add_ehypha_direct(pub_publickey, endpoint))} {
+		for (int fd : this->sub.get_fds()) {
+			this->sub_items.push_back(pollfd{fd, POLLIN, 0});
+		}
+	}
+
+	// Slow joiner: emits until subscriber has got what it waits for
+	void join(const function<void()>& emit, const function<bool()>& joined) {
+		while (!joined()) {
+			emit();
+			this->pub.update(); // ZAP
+			this->sub.wait_update(10);
+		}
+	}
+
+	// Blocks until subscriber is ready to update, without updating it, so that update() alone can be timed
+	void poll_sub(const int timeout_ms=100) {
+		poll(this->sub_items.data(), this->sub_items.size(), timeout_ms);
+	}
+
+	// Updates subscriber until etale has counted more than msgs_num messages
+	void receive(const Emyzelium::Etale& etale, const uint64_t msgs_num) {
+		while (etale.stats().msgs_num == msgs_num) {
+			this->poll_sub();
+			this->sub.update();
+		}
+	}
+};
+
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Benchmark: heap allocations per received etale, in steady state of fixed-size stream (as of demo's zone),
+ * without and with I/O thread (i.e. etale snapshots), counted by interposing malloc() of glibc in entire process,
+ * so allocations of ZeroMQ itself (incl. its I/O thread, e.g. for decrypted frames) are counted as well
+ */
+
+#include "bench.hpp"
+
+#include <cstdio>
+#include <thread>
+
+
+extern "C" {
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t num, size_t size);
+	void* __libc_realloc(void* ptr, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+}
+
+
+atomic<uint64_t> allocs_num{0};
+
+extern "C" {
+	void* malloc(size_t size) {
+		allocs_num.fetch_add(1, memory_order_relaxed);
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t num, size_t size) {
+		allocs_num.fetch_add(1, memory_order_relaxed);
+		return __libc_calloc(num, size);
+	}
+
+	void* realloc(void* ptr, size_t size) {
+		allocs_num.fetch_add(1, memory_order_relaxed);
+		return __libc_realloc(ptr, size);
+	}
+
+	void* memalign(size_t alignment, size_t size) {
+		allocs_num.fetch_add(1, memory_order_relaxed);
+		return __libc_memalign(alignment, size);
+	}
+}
+
+
+const size_t ZONE_HEIGHT = 48;
+const size_t ZONE_WIDTH = 80;
+
+const int WARMUP_ETALES_NUM = 1000;
+const int ETALES_NUM = 10000;
+
+
+double measure(const bool io_thread) {
+	PubSub ps("alloc");
+	ps.ehypha.add_etale("");
+	const Emyzelium::Etale& zone = get<0>(ps.ehypha.add_etale("zone"));
+
+	// Parts as in demo: header of 4 bytes and zone, same size each time; shared, so that emitting does not allocate them
+	vector<Emyzelium::shared_part> parts{make_shared<const vector<uint8_t>>(4, 0), make_shared<const vector<uint8_t>>(ZONE_HEIGHT * ZONE_WIDTH, 0)};
+
+	ps.join([&]() { ps.pub.emit_etale("zone", parts); }, [&]() { return zone.stats().msgs_num > 0; });
+
+	if (io_thread) {
+		ps.sub.start_io_thread(10);
+	}
+
+	uint64_t allocs_num_start = 0;
+	for (int i = 0; i < WARMUP_ETALES_NUM + ETALES_NUM; i++) {
+		if (i == WARMUP_ETALES_NUM) {
+			allocs_num_start = allocs_num.load();
+		}
+		uint64_t msgs_num = zone.stats().msgs_num;
+		ps.pub.emit_etale("zone", parts);
+		if (io_thread) {
+			while (zone.stats().msgs_num == msgs_num) {
+				// Reader takes snapshot and releases it before next one, like demo's frame
+				auto snapshot = get<0>(ps.ehypha.get_etale_snapshot("zone"));
+				this_thread::yield();
+			}
+		} else {
+			ps.receive(zone, msgs_num);
+		}
+	}
+	uint64_t allocs_num_end = allocs_num.load();
+
+	return double(allocs_num_end - allocs_num_start) / ETALES_NUM;
+}
+
+
+int main() {
+	printf("%12s %24s\n", "I/O thread", "allocations per etale");
+	for (bool io_thread : {false, true}) {
+		printf("%12s %24.2f\n", io_thread ? "yes" : "no", measure(io_thread));
+		fflush(stdout);
+	}
+
+	return 0;
+}
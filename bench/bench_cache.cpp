@@ -0,0 +1,96 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Benchmark: time from connection of new subscriber to its 1st etale of topic emitted once per EMIT_PERIOD_MSEC, as of demo's zone,
+ * without and with last-value cache of publisher (see Efunguz::set_emit_cache()), over ipc
+ */
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+
+const size_t ZONE_HEIGHT = 48;
+const size_t ZONE_WIDTH = 80;
+
+const int64_t EMIT_PERIOD_MSEC = 1000;
+const int JOINERS_NUM = 10;
+
+
+// Median over joiners, in milliseconds
+double measure(const bool caching) {
+	// Own subscribers instead of that of fixture, each joining anew
+	string pub_publickey;
+	string endpoint = bench_endpoint("cache");
+	Emyzelium::Efunguz pub(new_secretkey(pub_publickey), {}, vector<string>{endpoint});
+	pub.set_emit_cache(caching);
+
+	vector<Emyzelium::shared_part> parts{make_shared<const vector<uint8_t>>(4, 0), make_shared<const vector<uint8_t>>(ZONE_HEIGHT * ZONE_WIDTH, 0)};
+	int64_t t_emit = time_musec();
+	pub.emit_etale("zone", parts);
+
+	vector<double> waits;
+	for (int j = 0; j < JOINERS_NUM; j++) {
+		string publickey;
+		Emyzelium::Efunguz sub(new_secretkey(publickey), {}, vector<string>{});
+		int64_t t_start = time_musec();
+		auto& ehypha = *get<0>(sub.add_ehypha_direct(pub_publickey, endpoint));
+		const Emyzelium::Etale& zone = get<0>(ehypha.add_etale("zone"));
+		while (zone.t_in < 0) {
+			if (time_musec() - t_emit >= 1000 * EMIT_PERIOD_MSEC) {
+				t_emit = time_musec();
+				pub.emit_etale("zone", parts);
+			}
+			pub.wait_update(1); // ZAP, subscriptions
+			sub.wait_update(1);
+		}
+		waits.push_back(1e-3 * (time_musec() - t_start));
+	}
+
+	sort(waits.begin(), waits.end());
+	return waits[waits.size() / 2];
+}
+
+
+int main() {
+	printf("%8s %24s\n", "cache", "1st etale after, msec");
+	for (bool caching : {false, true}) {
+		printf("%8s %24.1f\n", caching ? "yes" : "no", measure(caching));
+		fflush(stdout);
+	}
+	printf("(etale emitted each %ld msec, median of %d subscribers joining one by one)\n", long(EMIT_PERIOD_MSEC), JOINERS_NUM);
+
+	return 0;
+}
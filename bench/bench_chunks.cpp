@@ -0,0 +1,146 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark: latency of short etale emitted every millisecond, while long etales of another topic are emitted as well,
+ * as one message each vs in chunks (see Efunguz::set_emit_chunking()), over ipc. Rate of chunks is either unlimited,
+ * so that only bytes per update() are, or limited as it would be to bandwidth of Tor circuit, so that queue of PUB socket stays short
+ */
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+
+const size_t LONG_ETALE_LEN = 2 << 20;
+const int64_t LONG_ETALE_PERIOD_MUSEC = 200000;
+const size_t CHUNK_LEN = 64 << 10;
+const size_t CHUNKS_RATE = 16 << 20; // bytes per second
+
+const int64_t DURATION_MUSEC = 4000000;
+
+
+struct Result {
+	size_t short_num;
+	int64_t short_p50;
+	int64_t short_p99;
+	int64_t short_max;
+	size_t long_num;
+	int64_t long_max;
+};
+
+
+Result measure(const bool chunked, const size_t chunks_rate) {
+	PubSub ps("chunks");
+	Emyzelium::Efunguz& pub = ps.pub;
+	Emyzelium::Efunguz& sub = ps.sub;
+	const Emyzelium::Etale& short_etale = get<0>(ps.ehypha.add_etale("short"));
+	const Emyzelium::Etale& long_etale = get<0>(ps.ehypha.add_etale("long"));
+
+	ps.join([&]() { pub.emit_etale("short", vector<vector<uint8_t>>{{0}}); }, [&]() { return short_etale.t_in >= 0; });
+
+	if (chunked) {
+		pub.set_emit_chunking(CHUNK_LEN, chunks_rate);
+	}
+	pub.start_io_thread(10);
+
+	// Subscriber in its own thread, which notes latency of each etale it receives
+	atomic<bool> running{true};
+	vector<int64_t> short_lats;
+	vector<int64_t> long_lats;
+	thread sub_thread([&]() {
+		int64_t t_out_short = short_etale.t_out;
+		int64_t t_out_long = long_etale.t_out;
+		while (running) {
+			sub.wait_update(10);
+			if (short_etale.t_out != t_out_short) {
+				t_out_short = short_etale.t_out;
+				short_lats.push_back(short_etale.t_in - short_etale.t_out);
+			}
+			if (long_etale.t_out != t_out_long) {
+				t_out_long = long_etale.t_out;
+				long_lats.push_back(long_etale.t_in - long_etale.t_out);
+			}
+		}
+	});
+
+	vector<Emyzelium::shared_part> long_parts{make_shared<const vector<uint8_t>>(LONG_ETALE_LEN, 1)};
+	int64_t t_start = wall_time_musec();
+	int64_t t_long = t_start;
+	while (wall_time_musec() - t_start < DURATION_MUSEC) {
+		pub.emit_etale("short", vector<vector<uint8_t>>{{1}});
+		if (wall_time_musec() >= t_long) {
+			pub.emit_etale("long", long_parts);
+			t_long += LONG_ETALE_PERIOD_MUSEC;
+		}
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+	this_thread::sleep_for(chrono::milliseconds(500));
+	running = false;
+	sub_thread.join();
+	pub.stop_io_thread();
+
+	Result res{};
+	sort(short_lats.begin(), short_lats.end());
+	res.short_num = short_lats.size();
+	if (!short_lats.empty()) {
+		res.short_p50 = short_lats[short_lats.size() / 2];
+		res.short_p99 = short_lats[short_lats.size() * 99 / 100];
+		res.short_max = short_lats.back();
+	}
+	res.long_num = long_lats.size();
+	if (!long_lats.empty()) {
+		res.long_max = *max_element(long_lats.begin(), long_lats.end());
+	}
+	return res;
+}
+
+
+int main() {
+	printf("%10s %8s %12s %12s %12s %8s %12s\n", "long ones", "short", "p50, musec", "p99, musec", "max, musec", "long", "max, musec");
+	struct Kind {
+		const char* name;
+		bool chunked;
+		size_t chunks_rate;
+	};
+	for (const Kind& kind : {Kind{"whole", false, 0}, Kind{"chunked", true, 0}, Kind{"limited", true, CHUNKS_RATE}}) {
+		Result r = measure(kind.chunked, kind.chunks_rate);
+		printf("%10s %8zu %12lld %12lld %12lld %8zu %12lld\n", kind.name, r.short_num, (long long)r.short_p50, (long long)r.short_p99, (long long)r.short_max, r.long_num, (long long)r.long_max);
+		fflush(stdout);
+	}
+	printf("(long etale of %zu bytes each %lld ms, chunks of %zu bytes, unlimited or at most %zu bytes/s)\n", LONG_ETALE_LEN, (long long)(LONG_ETALE_PERIOD_MUSEC / 1000), CHUNK_LEN, CHUNKS_RATE);
+
+	return 0;
+}
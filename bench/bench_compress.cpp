@@ -0,0 +1,172 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark: bytes on wire vs CPU of Rle compression (see Efunguz::set_emit_compression()) and of delta encoding
+ * (see Efunguz::set_emit_delta()) of demo's zone etale, for successive generations of Life at several densities, over ipc. CPU is of entire process, i.e. of both peers incl. Curve of ZeroMQ,
+ * which encrypts fewer bytes when they are compressed
+ */
+
+#include "bench.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <time.h>
+
+
+const int ZONE_HEIGHT = 48;
+const int ZONE_WIDTH = 80;
+
+const int ZONES_NUM = 2000;
+const int GENERATIONS_NUM = 256;
+const size_t KEYFRAME_INTERVAL = 16;
+
+
+int64_t cpu_time_nsec() {
+	timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+
+// As in demo: B3/S23 on torus
+void life_step(vector<uint8_t>& cells) {
+	vector<uint8_t> next(cells.size());
+	for (int y = 0; y < ZONE_HEIGHT; y++) {
+		for (int x = 0; x < ZONE_WIDTH; x++) {
+			int n = 0;
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					if ((dy != 0) || (dx != 0)) {
+						n += cells[((y + dy + ZONE_HEIGHT) % ZONE_HEIGHT) * ZONE_WIDTH + (x + dx + ZONE_WIDTH) % ZONE_WIDTH];
+					}
+				}
+			}
+			next[y * ZONE_WIDTH + x] = ((n == 3) || ((n == 2) && (cells[y * ZONE_WIDTH + x] == 1))) ? 1 : 0;
+		}
+	}
+	swap(cells, next);
+}
+
+
+vector<uint8_t> random_cells(const double density, mt19937& rng) {
+	vector<uint8_t> cells(ZONE_HEIGHT * ZONE_WIDTH);
+	uniform_real_distribution<double> uniform(0.0, 1.0);
+	for (auto& cell : cells) {
+		cell = (uniform(rng) < density) ? 1 : 0;
+	}
+	return cells;
+}
+
+
+vector<vector<uint8_t>> zone_etale(const vector<uint8_t>& cells) {
+	vector<vector<uint8_t>> parts{vector<uint8_t>(2), vector<uint8_t>(2), cells};
+	uint16_t zh = ZONE_HEIGHT;
+	uint16_t zw = ZONE_WIDTH;
+	memcpy(parts[0].data(), &zh, 2);
+	memcpy(parts[1].data(), &zw, 2);
+	return parts;
+}
+
+
+struct Result {
+	double bytes_per_zone;
+	double cpu_musec;
+};
+
+
+Result measure(const vector<vector<vector<uint8_t>>>& etales, const Emyzelium::Ecodec codec, const size_t keyframe_interval) {
+	PubSub ps("compress");
+	Emyzelium::Efunguz& pub = ps.pub;
+	pub.set_emit_compression("zone", codec);
+	pub.set_emit_delta("zone", keyframe_interval);
+	const Emyzelium::Etale& zone = get<0>(ps.ehypha.add_etale("zone"));
+
+	// Until some keyframe gets through
+	ps.join([&]() { pub.emit_etale("zone", etales[0]); }, [&]() { return zone.t_in >= 0; });
+
+	uint64_t packed_bytes_num_start = pub.emit_stats()["zone"].packed_bytes_num;
+	int64_t t_cpu = 0;
+	for (int i = 0; i < ZONES_NUM; i++) {
+		const auto& parts = etales[i % etales.size()];
+		uint64_t msgs_num = zone.stats().msgs_num;
+		int64_t t_start = cpu_time_nsec();
+		pub.emit_etale("zone", parts);
+		ps.receive(zone, msgs_num);
+		t_cpu += cpu_time_nsec() - t_start;
+		if (zone.parts() != parts) {
+			fprintf(stderr, "Zone %d received corrupted\n", i);
+			exit(1);
+		}
+	}
+
+	Result res;
+	res.bytes_per_zone = double(pub.emit_stats()["zone"].packed_bytes_num - packed_bytes_num_start) / ZONES_NUM;
+	res.cpu_musec = 1e-3 * t_cpu / ZONES_NUM;
+	return res;
+}
+
+
+int main() {
+	mt19937 rng(12345);
+
+	printf("%24s %8s %8s %8s %12s %12s %12s\n", "zones", "raw, B", "rle, B", "delta, B", "raw, musec", "rle, musec", "delta, musec");
+	struct Kind {
+		const char* name;
+		double density;
+		int skipped_generations; // -1 for independent random zones
+	};
+	for (const Kind& kind : {Kind{"empty", 0.0, 0}, Kind{"soup 0.3, settled", 0.3, 200}, Kind{"soup 0.3", 0.3, 0}, Kind{"noise 0.5", 0.5, -1}}) {
+		vector<vector<vector<uint8_t>>> etales;
+		vector<uint8_t> cells = random_cells(kind.density, rng);
+		for (int g = 0; g < kind.skipped_generations; g++) {
+			life_step(cells);
+		}
+		for (int i = 0; i < GENERATIONS_NUM; i++) {
+			etales.push_back(zone_etale(cells));
+			if (kind.skipped_generations >= 0) {
+				life_step(cells);
+			} else {
+				cells = random_cells(kind.density, rng);
+			}
+		}
+		Result raw = measure(etales, Emyzelium::Ecodec::Raw, 0);
+		Result rle = measure(etales, Emyzelium::Ecodec::Rle, 0);
+		Result delta = measure(etales, Emyzelium::Ecodec::Rle, KEYFRAME_INTERVAL);
+		printf("%24s %8.0f %8.0f %8.0f %12.2f %12.2f %12.2f\n", kind.name, raw.bytes_per_zone, rle.bytes_per_zone, delta.bytes_per_zone, raw.cpu_musec, rle.cpu_musec, delta.cpu_musec);
+		fflush(stdout);
+	}
+	printf("(delta with keyframe of each %zu zones; CPU per zone)\n", KEYFRAME_INTERVAL);
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark: cost of catching up with burst of queued etales (as of demo's zone, compressed) after stall of I/O thread,
+ * spread over 1 to 100 topics, without and with conflation (see Ehypha::set_conflating()); time includes start of I/O thread
+ */
+
+#include "bench.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+
+const size_t ZONE_HEIGHT = 48;
+const size_t ZONE_WIDTH = 80;
+
+const int BURST_ETALES_NUM = 400; // well below default high-water mark of SUB socket (1000, less unreported reads), so that none is held back
+const int ROUNDS_NUM = 20;
+
+
+double measure(const int topics_num, const bool conflating) {
+	PubSub ps("conflate");
+	Emyzelium::Efunguz& pub = ps.pub;
+	Emyzelium::Efunguz& sub = ps.sub;
+	Emyzelium::Ehypha& ehypha = ps.ehypha;
+	ehypha.set_conflating(conflating);
+	vector<string> titles;
+	for (int i = 0; i < topics_num; i++) {
+		titles.push_back("zone" + to_string(i));
+		ehypha.add_etale(titles.back());
+		pub.set_emit_compression(titles.back(), Emyzelium::Ecodec::Rle);
+	}
+
+	vector<Emyzelium::shared_part> parts{make_shared<const vector<uint8_t>>(4, 0), make_shared<const vector<uint8_t>>(ZONE_HEIGHT * ZONE_WIDTH, 0)};
+
+	// Until each topic gets through
+	ps.join([&]() {
+		for (const auto& title : titles) {
+			pub.emit_etale(title, parts);
+		}
+	}, [&]() {
+		for (const auto& title : titles) {
+			if (get<0>(ehypha.get_etale_ptr(title))->stats().msgs_num == 0) {
+				return false;
+			}
+		}
+		return true;
+	});
+
+	int64_t t_best = INT64_MAX;
+	for (int r = 0; r < ROUNDS_NUM; r++) {
+		sub.update();
+		uint64_t msgs_num = ehypha.stats().msgs_num;
+		// While I/O thread is stopped, burst piles up in queue of SUB socket
+		for (int i = 0; i < BURST_ETALES_NUM; i++) {
+			pub.emit_etale(titles[i % topics_num], parts);
+		}
+		this_thread::sleep_for(chrono::milliseconds(200));
+
+		int64_t t_start = time_musec();
+		sub.start_io_thread(10);
+		while (ehypha.stats().msgs_num < msgs_num + BURST_ETALES_NUM) {
+			this_thread::yield();
+		}
+		t_best = min(t_best, time_musec() - t_start);
+		sub.stop_io_thread();
+	}
+
+	return double(t_best);
+}
+
+
+int main() {
+	printf("%8s %24s %24s\n", "topics", "catch-up, musec", "conflating, musec");
+	for (int topics_num : {1, 10, 100}) {
+		double t = measure(topics_num, false);
+		double t_conflating = measure(topics_num, true);
+		printf("%8d %24.1f %24.1f\n", topics_num, t, t_conflating);
+		fflush(stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,347 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark: end-to-end emit_etale() -> Etale, N publishers and M subscribers in one process,
+ * over ipc or loopback tcp (inproc is not secured by Curve, so not supported),
+ * sweeping payload size (per part), parts per etale and topics per publisher.
+ *
+ * Throughput: each publisher emits windows of etales round-robin over its topics, by shared parts (no copying);
+ * a window is bounded by HWM and by bytes in flight, so nothing is dropped, and ends when each subscriber has got
+ * the last etale of each topic. msgs_per_s and mb_per_s are summed over subscribers, i.e. what they receive.
+ *
+ * Latency: one etale at a time from each publisher, t_in - t_out of each subscriber's etale, in microseconds
+ * (resolution of t_out and t_in). Subscribers are driven by one thread that polls all their fds, then updates them.
+ *
+ * Usage: bench-e2e [ipc|tcp] [publishers] [subscribers] [quick]
+ * Prints JSON to stdout.
+ */
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <poll.h>
+
+
+const uint16_t BASE_PORT = 60910;
+
+const int WINDOW_MAX_NUM = 500; // half of default SNDHWM and RCVHWM
+const size_t WINDOW_MAX_BYTES = 64 << 20;
+
+const int64_t THROUGHPUT_DURATION_MUSEC = 500000;
+const int64_t LATENCY_DURATION_MUSEC = 300000;
+const int LATENCY_MAX_PINGS = 1000;
+const int LATENCY_MIN_PINGS = 20;
+
+const long RECV_TIMEOUT_MS = 5000;
+
+
+struct Config {
+	size_t payload;
+	size_t parts;
+	size_t topics;
+};
+
+
+struct Result {
+	Config config;
+	uint64_t msgs;
+	double msgs_per_s;
+	double mb_per_s;
+	size_t pings;
+	int64_t lat_p50;
+	int64_t lat_p99;
+	int64_t lat_p999;
+	bool timed_out;
+};
+
+
+// Waits for the next microsecond, so that t_out of etales emitted from now on exceed those emitted before
+int64_t next_mark() {
+	int64_t t_prev = wall_time_musec();
+	int64_t t;
+	while ((t = wall_time_musec()) <= t_prev) {}
+	return t;
+}
+
+
+class Bench {
+	string transport;
+	vector<Emyzelium::Efunguz*> pubs;
+	vector<Emyzelium::Efunguz*> subs;
+	vector<string> pub_publickeys;
+	vector<string> endpoints;
+	size_t topics_num;
+	vector<vector<Emyzelium::Ehypha*>> sub_ehyphae; // [sub][pub]
+	vector<int> sub_fds;
+
+public:
+	Bench(const string& transport, const size_t pubs_num, const size_t subs_num)
+	: transport {transport}, topics_num {0} {
+		string publickey;
+		for (size_t i = 0; i < pubs_num; i++) {
+			string endpoint = (transport == "tcp") ? ("tcp://127.0.0.1:" + to_string(BASE_PORT + i)) : bench_endpoint("e2e" + to_string(i));
+			this->pubs.push_back(new Emyzelium::Efunguz(new_secretkey(publickey), {}, vector<string>{endpoint}));
+			this->pub_publickeys.push_back(publickey);
+			this->endpoints.push_back(endpoint);
+		}
+		for (size_t j = 0; j < subs_num; j++) {
+			this->subs.push_back(new Emyzelium::Efunguz(new_secretkey(publickey), {}, vector<string>{}));
+		}
+		for (auto sub : this->subs) {
+			for (int fd : sub->get_fds()) {
+				this->sub_fds.push_back(fd);
+			}
+		}
+	}
+
+	// Re-creates ehyphae, so that no etale survives from previous config
+	void subscribe(const size_t topics_num) {
+		this->topics_num = topics_num;
+		this->sub_ehyphae.assign(this->subs.size(), vector<Emyzelium::Ehypha*>(this->pubs.size(), nullptr));
+		for (size_t j = 0; j < this->subs.size(); j++) {
+			for (size_t i = 0; i < this->pubs.size(); i++) {
+				this->subs[j]->del_ehypha(this->pub_publickeys[i]);
+				auto eh = get<0>(this->subs[j]->add_ehypha_direct(this->pub_publickeys[i], this->endpoints[i]));
+				for (size_t k = 0; k < topics_num; k++) {
+					eh->add_etale(topic(k));
+				}
+				this->sub_ehyphae[j][i] = eh;
+			}
+		}
+	}
+
+	static string topic(const size_t k) {
+		return "t" + to_string(k);
+	}
+
+	static vector<size_t> range(const size_t n) {
+		vector<size_t> r;
+		for (size_t i = 0; i < n; i++) {
+			r.push_back(i);
+		}
+		return r;
+	}
+
+	void update_all(const long timeout_ms) {
+		vector<pollfd> items;
+		for (int fd : this->sub_fds) {
+			items.push_back(pollfd{fd, POLLIN, 0});
+		}
+		poll(items.data(), items.size(), timeout_ms);
+		for (auto sub : this->subs) {
+			sub->update();
+		}
+		for (auto pub : this->pubs) {
+			pub->update(); // ZAP requests
+		}
+	}
+
+	const Emyzelium::Etale* etale(const size_t j, const size_t i, const size_t k) {
+		return get<0>(this->sub_ehyphae[j][i]->get_etale_ptr(topic(k)));
+	}
+
+	// Whether each subscriber has etales of listed publishers and topics emitted not earlier than t_mark
+	bool received(const vector<size_t>& pub_ids, const vector<size_t>& topic_ids, const int64_t t_mark) {
+		for (size_t j = 0; j < this->subs.size(); j++) {
+			for (size_t i : pub_ids) {
+				for (size_t k : topic_ids) {
+					if (this->etale(j, i, k)->t_out < t_mark) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	bool wait_received(const vector<size_t>& pub_ids, const vector<size_t>& topic_ids, const int64_t t_mark, const int64_t timeout_musec) {
+		int64_t t_start = wall_time_musec();
+		while (!this->received(pub_ids, topic_ids, t_mark)) {
+			if (wall_time_musec() - t_start > timeout_musec) {
+				return false;
+			}
+			this->update_all(10);
+		}
+		return true;
+	}
+
+	// Slow joiner: emit until every subscription is in place
+	bool warm_up() {
+		vector<size_t> pub_ids = range(this->pubs.size());
+		vector<size_t> topic_ids = range(this->topics_num);
+		for (int attempt = 0; attempt < 200; attempt++) {
+			int64_t t_mark = next_mark();
+			for (auto pub : this->pubs) {
+				for (size_t k = 0; k < this->topics_num; k++) {
+					pub->emit_etale(topic(k), vector<vector<uint8_t>>{{0}});
+				}
+			}
+			if (this->wait_received(pub_ids, topic_ids, t_mark, 100000)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Result run(const Config& config, const bool quick) {
+		Result res{};
+		res.config = config;
+
+		this->subscribe(config.topics);
+		if (!this->warm_up()) {
+			res.timed_out = true;
+			return res;
+		}
+
+		vector<Emyzelium::shared_part> parts;
+		for (size_t p = 0; p < config.parts; p++) {
+			parts.push_back(make_shared<const vector<uint8_t>>(config.payload, uint8_t(p)));
+		}
+		size_t msg_bytes = config.payload * config.parts;
+		int window = int(max(size_t(1), min(size_t(WINDOW_MAX_NUM), WINDOW_MAX_BYTES / max(size_t(1), msg_bytes * this->pubs.size()))));
+		int64_t duration = quick ? (THROUGHPUT_DURATION_MUSEC / 10) : THROUGHPUT_DURATION_MUSEC;
+
+		// Throughput
+		vector<size_t> pub_ids = range(this->pubs.size());
+		uint64_t msgs_emitted = 0;
+		int64_t t_start = wall_time_musec();
+		size_t k_next = 0;
+		do {
+			// All but the last etale of each topic in window, then the last ones, marked by time
+			int final_num = int(min(size_t(window), config.topics));
+			for (int w = 0; w < window - final_num; w++) {
+				for (auto pub : this->pubs) {
+					pub->emit_etale(topic(k_next), parts);
+				}
+				k_next = (k_next + 1) % config.topics;
+			}
+			int64_t t_mark = next_mark();
+			vector<size_t> topic_ids;
+			for (int w = 0; w < final_num; w++) {
+				for (auto pub : this->pubs) {
+					pub->emit_etale(topic(k_next), parts);
+				}
+				topic_ids.push_back(k_next);
+				k_next = (k_next + 1) % config.topics;
+			}
+			if (!this->wait_received(pub_ids, topic_ids, t_mark, RECV_TIMEOUT_MS * 1000)) {
+				res.timed_out = true;
+				return res;
+			}
+			msgs_emitted += window * this->pubs.size();
+		} while (wall_time_musec() - t_start < duration);
+		double dt = double(wall_time_musec() - t_start) * 1e-6;
+		res.msgs = msgs_emitted * this->subs.size();
+		res.msgs_per_s = double(res.msgs) / dt;
+		res.mb_per_s = double(res.msgs) * double(msg_bytes) / dt / double(1 << 20);
+
+		// Latency
+		vector<int64_t> lats;
+		duration = quick ? (LATENCY_DURATION_MUSEC / 10) : LATENCY_DURATION_MUSEC;
+		t_start = wall_time_musec();
+		size_t pings = 0;
+		size_t min_pings = quick ? (LATENCY_MIN_PINGS / 4) : LATENCY_MIN_PINGS;
+		while (((wall_time_musec() - t_start < duration) && (pings < LATENCY_MAX_PINGS)) || (pings < min_pings)) {
+			size_t i = pings % this->pubs.size();
+			int64_t t_mark = next_mark();
+			this->pubs[i]->emit_etale(topic(0), parts);
+			if (!this->wait_received({i}, {0}, t_mark, RECV_TIMEOUT_MS * 1000)) {
+				res.timed_out = true;
+				return res;
+			}
+			for (size_t j = 0; j < this->subs.size(); j++) {
+				auto et = this->etale(j, i, 0);
+				lats.push_back(et->t_in - et->t_out);
+			}
+			pings++;
+		}
+		sort(lats.begin(), lats.end());
+		res.pings = pings;
+		res.lat_p50 = lats[lats.size() * 50 / 100];
+		res.lat_p99 = lats[lats.size() * 99 / 100];
+		res.lat_p999 = lats[lats.size() * 999 / 1000];
+
+		return res;
+	}
+
+	~Bench() {
+		for (auto sub : this->subs) {
+			delete sub;
+		}
+		for (auto pub : this->pubs) {
+			delete pub;
+		}
+	}
+};
+
+
+int main(int argc, char** argv) {
+	vector<string> args(argv, argv + argc);
+	string transport = (args.size() > 1) ? args[1] : "ipc";
+	if ((transport != "ipc") && (transport != "tcp")) {
+		fprintf(stderr, "Syntax: bench-e2e [ipc|tcp] [publishers] [subscribers] [quick]\n");
+		return 1;
+	}
+	size_t pubs_num = (args.size() > 2) ? max(1, stoi(args[2])) : 1;
+	size_t subs_num = (args.size() > 3) ? max(1, stoi(args[3])) : 1;
+	bool quick = (args.size() > 4) && (args[4] == "quick");
+
+	vector<size_t> payloads = {16, 256, 4 << 10, 64 << 10, 1 << 20, 16 << 20};
+	vector<size_t> parts_nums = {1, 4};
+	vector<size_t> topics_nums = {1, 16};
+
+	Bench bench(transport, pubs_num, subs_num);
+
+	printf("{\n");
+	printf("  \"lib_version\": \"%s\",\n", Emyzelium::LIB_VERSION.c_str());
+	printf("  \"transport\": \"%s\",\n", transport.c_str());
+	printf("  \"publishers\": %zu,\n", pubs_num);
+	printf("  \"subscribers\": %zu,\n", subs_num);
+	printf("  \"results\": [");
+	bool first = true;
+	for (size_t payload : payloads) {
+		for (size_t parts : parts_nums) {
+			for (size_t topics : topics_nums) {
+				Result r = bench.run(Config{payload, parts, topics}, quick);
+				printf("%s\n    {\"payload\": %zu, \"parts\": %zu, \"topics\": %zu, \"timed_out\": %s, \"msgs\": %llu, \"msgs_per_s\": %.1f, \"mb_per_s\": %.3f, \"pings\": %zu, \"lat_p50_us\": %lld, \"lat_p99_us\": %lld, \"lat_p999_us\": %lld}",
+					first ? "" : ",", payload, parts, topics, r.timed_out ? "true" : "false", (unsigned long long)r.msgs, r.msgs_per_s, r.mb_per_s, r.pings, (long long)r.lat_p50, (long long)r.lat_p99, (long long)r.lat_p999);
+				fflush(stdout);
+				first = false;
+			}
+		}
+	}
+	printf("\n  ]\n}\n");
+
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Benchmark: cost of Ehypha's update per received etale vs number of topics (etales) of ehypha,
+ * and, in isolation, of lookup of etale by topic frame: Etable vs unordered_map<string, Etale> with count() and at()
+ */
+
+#include "bench.hpp"
+
+#include <cstring>
+#include <unordered_map>
+#include <cstdio>
+
+
+const int WINDOW_NUM = 500; // half of default SNDHWM and RCVHWM, so nothing is dropped
+const int WINDOWS_NUM = 200;
+
+const int LOOKUPS_NUM = 10000000;
+
+
+double measure(const size_t topics_num) {
+	PubSub ps("topics");
+	Emyzelium::Ehypha& ehypha = ps.ehypha;
+	vector<string> titles;
+	for (size_t k = 0; k < topics_num; k++) {
+		titles.push_back("topic/" + to_string(k) + "/of/some/realistic/length");
+		ehypha.add_etale(titles.back());
+	}
+
+	ps.join([&]() { ps.pub.emit_etale(titles[0], vector<vector<uint8_t>>{{0}}); }, [&]() { return ehypha.stats().msgs_num > 0; });
+
+	vector<Emyzelium::shared_part> parts{make_shared<const vector<uint8_t>>(16, 0)};
+	uint64_t msgs_num_start = ehypha.stats().msgs_num;
+	uint64_t msgs_num = msgs_num_start;
+	int64_t t_update = 0;
+	size_t k = 0;
+	for (int w = 0; w < WINDOWS_NUM; w++) {
+		for (int i = 0; i < WINDOW_NUM; i++) {
+			ps.pub.emit_etale(titles[k], parts);
+			k = (k + 1) % topics_num;
+		}
+		uint64_t msgs_num_end = msgs_num + WINDOW_NUM;
+		while (msgs_num < msgs_num_end) {
+			ps.poll_sub(); // not timed
+			int64_t t_start = time_nsec();
+			ps.sub.update();
+			t_update += time_nsec() - t_start;
+			msgs_num = ehypha.stats().msgs_num;
+		}
+	}
+
+	return double(t_update) / double(msgs_num - msgs_num_start);
+}
+
+
+// Per lookup, nsec: {Etable, unordered_map}
+tuple<double, double> measure_lookup(const size_t topics_num) {
+	Emyzelium::Etable table;
+	unordered_map<string, Emyzelium::Etale> map;
+	vector<vector<char>> frames; // topic frames as received, with terminating zero
+	for (size_t k = 0; k < topics_num; k++) {
+		string title = "topic/" + to_string(k) + "/of/some/realistic/length";
+		table.emplace(title);
+		map.emplace(piecewise_construct, tuple<string>{title}, tuple<>{});
+		frames.emplace_back(title.c_str(), title.c_str() + title.size() + 1);
+	}
+
+	size_t found_num = 0;
+	int64_t t_start = time_nsec();
+	for (int i = 0; i < LOOKUPS_NUM; i++) {
+		const vector<char>& frame = frames[size_t(i) % topics_num];
+		found_num += (table.find(frame.data(), frame.size() - 1) != nullptr);
+	}
+	double t_table = double(time_nsec() - t_start) / LOOKUPS_NUM;
+
+	t_start = time_nsec();
+	for (int i = 0; i < LOOKUPS_NUM; i++) {
+		string title(frames[size_t(i) % topics_num].data());
+		if (map.count(title) == 1) {
+			found_num += (&(map.at(title)) != nullptr);
+		}
+	}
+	double t_map = double(time_nsec() - t_start) / LOOKUPS_NUM;
+
+	if (found_num != 2 * size_t(LOOKUPS_NUM)) {
+		printf("Lookup failed\n");
+	}
+	return tuple<double, double>{t_table, t_map};
+}
+
+
+int main() {
+	printf("%10s %24s %24s %24s\n", "topics", "update per etale, nsec", "Etable lookup, nsec", "unordered_map, nsec");
+	for (size_t topics_num : {1, 100, 10000}) {
+		double t_update = measure(topics_num);
+		auto t_lookup = measure_lookup(topics_num);
+		printf("%10zu %24.1f %24.1f %24.1f\n", topics_num, t_update, get<0>(t_lookup), get<1>(t_lookup));
+		fflush(stdout);
+	}
+
+	return 0;
+}
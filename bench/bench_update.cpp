@@ -0,0 +1,123 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark: cost of Efunguz::update() vs number of idle ehyphae
+ */
+
+#include "bench.hpp"
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+
+const string SECRETKEY = "gr6Y.04i(&Y27ju0g7m0HvhG0:rDmx<Y[FvH@*N(";
+
+const uint16_t PUBSUB_PORT = 60901;
+
+const int UPDATES_NUM = 2000;
+
+
+// "Tor proxy" that accepts TCP connections (by kernel backlog) but never answers SOCKS greeting,
+// so that each ehypha stays connecting, without reconnection attempts, i.e. idle
+int open_silent_proxy(uint16_t& port) {
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	bind(fd, (sockaddr*)&addr, sizeof(addr));
+	listen(fd, 65535);
+	socklen_t addr_len = sizeof(addr);
+	getsockname(fd, (sockaddr*)&addr, &addr_len);
+	port = ntohs(addr.sin_port);
+	return fd;
+}
+
+
+void raise_fds_limit() {
+	rlimit lim{};
+	getrlimit(RLIMIT_NOFILE, &lim);
+	lim.rlim_cur = lim.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &lim);
+}
+
+
+double measure(const int ehyphae_num, const uint16_t proxy_port) {
+	Emyzelium::Efunguz efunguz(SECRETKEY, {}, PUBSUB_PORT, proxy_port);
+
+	string publickey;
+	for (int i = 0; i < ehyphae_num; i++) {
+		new_secretkey(publickey);
+		auto& ehypha = get<0>(efunguz.add_ehypha(publickey, "idle" + to_string(i)));
+		ehypha.add_etale("");
+		ehypha.add_etale("zone");
+	}
+
+	// Let connection attempts settle
+	int64_t t_settle = time_musec();
+	while (time_musec() - t_settle < 500000) {
+		efunguz.update();
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+
+	int64_t t_start = time_musec();
+	for (int i = 0; i < UPDATES_NUM; i++) {
+		efunguz.update();
+	}
+	return double(time_musec() - t_start) / UPDATES_NUM;
+}
+
+
+int main() {
+	raise_fds_limit();
+
+	uint16_t proxy_port = 0;
+	int proxy_fd = open_silent_proxy(proxy_port);
+
+	printf("%10s %16s %20s\n", "ehyphae", "update, musec", "per ehypha, nsec");
+	for (int ehyphae_num : {10, 100, 1000, 10000}) {
+		double t = measure(ehyphae_num, proxy_port);
+		printf("%10d %16.3f %20.3f\n", ehyphae_num, t, 1e3 * t / ehyphae_num);
+		fflush(stdout);
+	}
+
+	close(proxy_fd);
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Benchmark: warm start from snapshot of etales (see Efunguz::save_snapshot() and load_snapshot()) of many topics with zones as in demo:
+ * time to save, to load (map) and to add all etales with and without loaded snapshot, i.e. how much warming up adds to subscribing
+ */
+
+#include "bench.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+
+const size_t ZONE_HEIGHT = 48;
+const size_t ZONE_WIDTH = 80;
+
+const int BURST_ETALES_NUM = 400; // well below default high-water mark of SUB socket
+
+
+struct Result {
+	double save_msec;
+	double file_mb;
+	double load_msec;
+	double add_cold_msec;
+	double add_warm_msec;
+};
+
+
+// Adds etales to new efunguz, with or without snapshot, and checks what they start with
+double add_etales(const string& pub_publickey, const string& endpoint, const vector<string>& titles, const vector<Emyzelium::shared_part>& parts, const string& snapshot_filepath, double& load_msec) {
+	string publickey;
+	Emyzelium::Efunguz efunguz(new_secretkey(publickey), {}, vector<string>{});
+	int64_t t_start = time_musec();
+	if (!snapshot_filepath.empty() && !efunguz.load_snapshot(snapshot_filepath)) {
+		fprintf(stderr, "Snapshot not loaded\n");
+		exit(1);
+	}
+	load_msec = 1e-3 * (time_musec() - t_start);
+	auto& ehypha = *get<0>(efunguz.add_ehypha_direct(pub_publickey, endpoint));
+	t_start = time_musec();
+	for (const auto& title : titles) {
+		ehypha.add_etale(title);
+	}
+	double add_msec = 1e-3 * (time_musec() - t_start);
+	for (const auto& title : titles) {
+		const auto& eparts = get<0>(ehypha.get_etale_ptr(title))->eparts();
+		bool warm = (eparts.size() == parts.size()) && (eparts[1].size() == parts[1]->size()) && (memcmp(eparts[1].data(), parts[1]->data(), eparts[1].size()) == 0);
+		if (warm != !snapshot_filepath.empty()) {
+			fprintf(stderr, "Etale %s started wrong\n", title.c_str());
+			exit(1);
+		}
+	}
+	return add_msec;
+}
+
+
+Result measure(const int topics_num) {
+	PubSub ps("warm");
+	Emyzelium::Ehypha& ehypha = ps.ehypha;
+	string snapshot_filepath = "/tmp/emyzelium-bench-warm-" + to_string(getpid()) + ".snap";
+	vector<string> titles;
+	for (int i = 0; i < topics_num; i++) {
+		titles.push_back("zone" + to_string(i));
+		ehypha.add_etale(titles.back());
+	}
+
+	vector<uint8_t> zone(ZONE_HEIGHT * ZONE_WIDTH);
+	for (size_t i = 0; i < zone.size(); i++) {
+		zone[i] = (i % 7 == 0) ? 1 : 0;
+	}
+	vector<Emyzelium::shared_part> parts{make_shared<const vector<uint8_t>>(4, 0), make_shared<const vector<uint8_t>>(zone)};
+
+	// Bursts of topics not yet received
+	ps.join([&]() {
+		int burst_num = 0;
+		for (const auto& title : titles) {
+			if ((get<0>(ehypha.get_etale_ptr(title))->t_in < 0) && (burst_num < BURST_ETALES_NUM)) {
+				ps.pub.emit_etale(title, parts);
+				burst_num++;
+			}
+		}
+	}, [&]() {
+		for (const auto& title : titles) {
+			if (get<0>(ehypha.get_etale_ptr(title))->t_in < 0) {
+				return false;
+			}
+		}
+		return true;
+	});
+
+	Result res;
+	int64_t t_start = time_musec();
+	if (!ps.sub.save_snapshot(snapshot_filepath)) {
+		fprintf(stderr, "Snapshot not saved\n");
+		exit(1);
+	}
+	res.save_msec = 1e-3 * (time_musec() - t_start);
+	FILE* f = fopen(snapshot_filepath.c_str(), "rb");
+	fseek(f, 0, SEEK_END);
+	res.file_mb = 1e-6 * ftell(f);
+	fclose(f);
+
+	double load_msec = 0.0;
+	res.add_cold_msec = add_etales(ps.pub_publickey, ps.endpoint, titles, parts, "", load_msec);
+	res.add_warm_msec = add_etales(ps.pub_publickey, ps.endpoint, titles, parts, snapshot_filepath, res.load_msec);
+	remove(snapshot_filepath.c_str());
+	return res;
+}
+
+
+int main() {
+	printf("%8s %12s %10s %12s %16s %16s\n", "topics", "save, msec", "file, MB", "load, msec", "add cold, msec", "add warm, msec");
+	for (int topics_num : {100, 1000, 10000}) {
+		Result res = measure(topics_num);
+		printf("%8d %12.2f %10.2f %12.3f %16.2f %16.2f\n", topics_num, res.save_msec, res.file_mb, res.load_msec, res.add_cold_msec, res.add_warm_msec);
+		fflush(stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Benchmark of LifeGrid::turn() (see life.hpp) against former Realm_CA::turn() of demo, byte per cell, which is also checked
+ * to give the same cells, for random B/S rules, sizes and soups, with cells flipped between turns. Then, on quiet world,
+ * LifeGrid that skips unchanged tiles vs one that does not. Build with -march=native to get AVX2 kernel where available
+ */
+
+#include "../bench/bench.hpp"
+#include "life.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+
+// Former Realm_CA::turn()
+struct ByteGrid {
+	int height;
+	int width;
+	vector<vector<uint8_t>> cells; // bits: 0 - current state, 1-4 - number of alive neighbours
+	set<int> birth;
+	set<int> survival;
+
+	ByteGrid(const int height, const int width, const set<int>& birth, const set<int>& survival)
+	: height {height}, width {width}, cells(height, vector<uint8_t>(width)), birth {birth}, survival {survival} {}
+
+	void turn() {
+		int h = this->height;
+		int w = this->width;
+		// Count alive neighbours
+		for (int y = 0; y < h; y++) {
+			for (int x = 0; x < w; x++) {
+				if (this->cells[y][x] & 1) { // increment number of neighbours for all neighbouring cells
+					for (int ny = y - 1; ny <= y + 1; ny++) {
+						if ((ny >= 0) && (ny < h)) {
+							for (int nx = x - 1; nx <= x + 1; nx++) {
+								if (((ny != y) || (nx != x)) && (nx >= 0) && (nx < w)) {
+									this->cells[ny][nx] += 2;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+		// Update
+		for (int y = 0; y < h; y++) {
+			for (int x = 0; x < w; x++) {
+				uint8_t c = this->cells[y][x];
+				if (c & 1) {
+					c = this->survival.count(c >> 1);
+				} else {
+					c = this->birth.count(c >> 1);
+				}
+				this->cells[y][x] = c;
+			}
+		}
+	}
+};
+
+
+void soup(ByteGrid& bytes, LifeGrid& bits, const double density, mt19937_64& rng) {
+	uniform_real_distribution<double> uniform(0.0, 1.0);
+	for (int y = 0; y < bytes.height; y++) {
+		for (int x = 0; x < bytes.width; x++) {
+			uint8_t c = (uniform(rng) < density) ? 1 : 0;
+			bytes.cells[y][x] = c;
+			bits.set_cell(y, x, c);
+		}
+	}
+}
+
+
+bool same(const ByteGrid& bytes, const LifeGrid& bits) {
+	for (int y = 0; y < bytes.height; y++) {
+		for (int x = 0; x < bytes.width; x++) {
+			if (bytes.cells[y][x] != bits.get_cell(y, x)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+set<int> random_set(mt19937_64& rng) {
+	set<int> s;
+	for (int n = 0; n <= 8; n++) {
+		if (rng() & 1) {
+			s.insert(n);
+		}
+	}
+	return s;
+}
+
+
+void check(mt19937_64& rng) {
+	const int SIZES[][2] = {{1, 1}, {2, 63}, {3, 64}, {5, 65}, {17, 127}, {31, 128}, {40, 200}, {64, 317}, {48, 80}, {100, 700}, {70, 1100}};
+	const int TURNS_NUM = 24;
+	int checks_num = 0;
+	for (int i_rule = 0; i_rule < 64; i_rule++) {
+		set<int> birth = (i_rule == 0) ? set<int>{3} : random_set(rng);
+		set<int> survival = (i_rule == 0) ? set<int>{2, 3} : random_set(rng);
+		for (const auto& size : SIZES) {
+			ByteGrid bytes(size[0], size[1], birth, survival);
+			LifeGrid bits(size[0], size[1], birth, survival);
+			soup(bytes, bits, 0.05 + 0.9 * (rng() % 1000) / 1000.0, rng);
+			for (int t = 0; t < TURNS_NUM; t++) {
+				if (t % 4 == 3) { // as by Realm_CA::flip() or put_etale_to_zone()
+					int y = rng() % size[0];
+					int x = rng() % size[1];
+					bytes.cells[y][x] ^= 1;
+					bits.flip_cell(y, x);
+				}
+				bytes.turn();
+				bits.turn();
+				if (!same(bytes, bits)) {
+					fprintf(stderr, "Mismatch: rule %d, size %dx%d, turn %d\n", i_rule, size[0], size[1], t + 1);
+					exit(1);
+				}
+				checks_num++;
+			}
+		}
+	}
+	printf("Check OK: %d turns of random rules and sizes same as byte per cell\n", checks_num);
+}
+
+
+template <typename G>
+double musec_per_turn(G& grid, const int turns_num) {
+	int64_t t_start = time_musec();
+	for (int t = 0; t < turns_num; t++) {
+		grid.turn();
+	}
+	return double(time_musec() - t_start) / turns_num;
+}
+
+
+int main() {
+	mt19937_64 rng(12345);
+
+	check(rng);
+
+	printf("Kernel: %s\n", LifeGrid::kernel_name());
+	printf("%12s %8s %14s %14s %10s %14s\n", "size", "turns", "bytes, musec", "bits, musec", "speedup", "bits, Gcell/s");
+	const int SIZES[][2] = {{48, 80}, {256, 256}, {1024, 1024}, {4096, 4096}};
+	for (const auto& size : SIZES) {
+		int h = size[0];
+		int w = size[1];
+		int turns_num = max(4, int(int64_t(1) << 26) / (h * w));
+		ByteGrid bytes(h, w, {3}, {2, 3});
+		LifeGrid bits(h, w, {3}, {2, 3});
+		soup(bytes, bits, 0.3, rng);
+		double bytes_musec = musec_per_turn(bytes, max(1, turns_num / 64));
+		double bits_musec = musec_per_turn(bits, turns_num);
+		printf("%12s %8d %14.1f %14.2f %10.1f %14.2f\n", (to_string(h) + "x" + to_string(w)).c_str(), turns_num, bytes_musec, bits_musec, bytes_musec / bits_musec, 1e-3 * h * w / bits_musec);
+		fflush(stdout);
+	}
+	printf("(B3/S23, soup 0.3; byte per cell turned 64 times less)\n");
+
+	// Quiet world: empty but for a few patches of soup, settled
+	const int QUIET_SIZE = 4096;
+	const int PATCHES_NUM = 4;
+	const int PATCH_SIZE = 128;
+	const int SETTLE_TURNS_NUM = 1000;
+	const int QUIET_TURNS_NUM = 200;
+	LifeGrid quiet(QUIET_SIZE, QUIET_SIZE, {3}, {2, 3});
+	uniform_real_distribution<double> uniform(0.0, 1.0);
+	for (int i = 0; i < PATCHES_NUM; i++) {
+		int py = rng() % (QUIET_SIZE - PATCH_SIZE);
+		int px = rng() % (QUIET_SIZE - PATCH_SIZE);
+		for (int y = 0; y < PATCH_SIZE; y++) {
+			for (int x = 0; x < PATCH_SIZE; x++) {
+				quiet.set_cell(py + y, px + x, (uniform(rng) < 0.3) ? 1 : 0);
+			}
+		}
+	}
+	for (int t = 0; t < SETTLE_TURNS_NUM; t++) {
+		quiet.turn();
+	}
+	printf("\nQuiet world %dx%d, %d patches %dx%d of soup 0.3 after %d turns, %d tiles:\n", QUIET_SIZE, QUIET_SIZE, PATCHES_NUM, PATCH_SIZE, PATCH_SIZE, SETTLE_TURNS_NUM, quiet.tiles_num());
+	printf("%12s %14s %14s\n", "skipping", "musec", "active tiles");
+	for (bool skipping : {false, true}) {
+		quiet.set_tiles_skipping(skipping);
+		quiet.turn();
+		printf("%12s %14.1f %14d\n", skipping ? "on" : "off", musec_per_turn(quiet, QUIET_TURNS_NUM), quiet.active_tiles_num());
+	}
+
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Benchmark: jump by many turns of LifeHash (see hashlife.hpp) vs so many turns of LifeGrid (see life.hpp), on quiet worlds
+ * of several sizes. Before that, both are checked to give the same cells, for random B/S rules, sizes, soups and jumps
+ */
+
+#include "../bench/bench.hpp"
+#include "hashlife.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+
+bool same(const LifeGrid& a, const LifeGrid& b, const int height, const int width) {
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			if (a.get_cell(y, x) != b.get_cell(y, x)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+set<int> random_set(mt19937_64& rng) {
+	set<int> s;
+	for (int n = 0; n <= 8; n++) {
+		if (rng() & 1) {
+			s.insert(n);
+		}
+	}
+	return s;
+}
+
+
+void check(mt19937_64& rng) {
+	const int SIZES[][2] = {{1, 1}, {3, 7}, {16, 16}, {17, 40}, {48, 80}, {100, 70}, {130, 300}};
+	const int JUMPS_NUM = 6;
+	int checks_num = 0;
+	for (int i_rule = 0; i_rule < 32; i_rule++) {
+		set<int> birth = (i_rule == 0) ? set<int>{3} : ((i_rule == 1) ? set<int>{3, 4} : random_set(rng));
+		set<int> survival = (i_rule == 0) ? set<int>{2, 3} : ((i_rule == 1) ? set<int>{3, 4} : random_set(rng));
+		for (const auto& size : SIZES) {
+			LifeGrid dense(size[0], size[1], birth, survival);
+			LifeGrid view(size[0], size[1], birth, survival);
+			LifeHash hash(size[0], size[1], birth, survival);
+			double density = 0.05 + 0.9 * (rng() % 1000) / 1000.0;
+			uniform_real_distribution<double> uniform(0.0, 1.0);
+			for (int y = 0; y < size[0]; y++) {
+				for (int x = 0; x < size[1]; x++) {
+					dense.set_cell(y, x, (uniform(rng) < density) ? 1 : 0);
+				}
+			}
+			hash.import_from(dense);
+			for (int i = 0; i < JUMPS_NUM; i++) {
+				uint64_t turns_num = rng() % 300;
+				hash.jump(turns_num);
+				for (uint64_t t = 0; t < turns_num; t++) {
+					dense.turn();
+				}
+				hash.export_to(view);
+				if (!same(dense, view, size[0], size[1])) {
+					fprintf(stderr, "Mismatch: rule %d, size %dx%d, jump %d by %lu turns\n", i_rule, size[0], size[1], i, turns_num);
+					exit(1);
+				}
+				checks_num++;
+			}
+		}
+	}
+	printf("Check OK: %d jumps of random rules and sizes same as dense\n", checks_num);
+}
+
+
+int main() {
+	mt19937_64 rng(12345);
+
+	check(rng);
+
+	// Quiet worlds: empty but for a few patches of soup
+	const int PATCHES_NUM = 4;
+	const int PATCH_SIZE = 128;
+	const uint64_t TURNS_NUM = 10000;
+	printf("Jump by %lu turns, B3/S23, %d patches %dx%d of soup 0.3:\n", TURNS_NUM, PATCHES_NUM, PATCH_SIZE, PATCH_SIZE);
+	printf("%12s %12s %12s %12s %10s %16s %12s\n", "size", "dense, ms", "import, ms", "jump, ms", "speedup", "next x10, ms", "nodes");
+	for (int size : {1024, 2048, 4096}) {
+		LifeGrid dense(size, size, {3}, {2, 3});
+		uniform_real_distribution<double> uniform(0.0, 1.0);
+		for (int i = 0; i < PATCHES_NUM; i++) {
+			int py = rng() % (size - PATCH_SIZE);
+			int px = rng() % (size - PATCH_SIZE);
+			for (int y = 0; y < PATCH_SIZE; y++) {
+				for (int x = 0; x < PATCH_SIZE; x++) {
+					dense.set_cell(py + y, px + x, (uniform(rng) < 0.3) ? 1 : 0);
+				}
+			}
+		}
+		LifeHash hash(size, size, {3}, {2, 3});
+		int64_t t_start = time_musec();
+		hash.import_from(dense);
+		int64_t t_import = time_musec() - t_start;
+		t_start = time_musec();
+		hash.jump(TURNS_NUM);
+		int64_t t_jump = time_musec() - t_start;
+		t_start = time_musec();
+		for (uint64_t t = 0; t < TURNS_NUM; t++) {
+			dense.turn();
+		}
+		int64_t t_dense = time_musec() - t_start;
+		LifeGrid view(size, size, {3}, {2, 3});
+		hash.export_to(view);
+		if (!same(dense, view, size, size)) {
+			fprintf(stderr, "Mismatch: size %d\n", size);
+			exit(1);
+		}
+		t_start = time_musec();
+		hash.jump(10 * TURNS_NUM);
+		int64_t t_jump_next = time_musec() - t_start;
+		printf("%12s %12.1f %12.1f %12.1f %10.1f %16.1f %12zu\n", (to_string(size) + "x" + to_string(size)).c_str(), 1e-3 * t_dense, 1e-3 * t_import, 1e-3 * t_jump, double(t_dense) / (t_import + t_jump), 1e-3 * t_jump_next, hash.nodes_num());
+		fflush(stdout);
+	}
+	printf("(dense skips unchanged tiles; speedup counts import too; next x10 is further jump by 10 times more turns)\n");
+
+	return 0;
+}
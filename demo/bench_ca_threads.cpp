@@ -0,0 +1,123 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Benchmark: turns per second of LifeGrid (see life.hpp) vs number of threads turning bands of rows, on large grids.
+ * Each number of threads is first checked to give the same cells as single thread
+ */
+
+#include "../bench/bench.hpp"
+#include "life.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+
+void soup(LifeGrid& grid, const int height, const int width, const double density, const uint64_t seed) {
+	mt19937_64 rng(seed);
+	uniform_real_distribution<double> uniform(0.0, 1.0);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			grid.set_cell(y, x, (uniform(rng) < density) ? 1 : 0);
+		}
+	}
+}
+
+
+bool same(const LifeGrid& a, const LifeGrid& b, const int height, const int width) {
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			if (a.get_cell(y, x) != b.get_cell(y, x)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+int main(int argc, char** argv) {
+	// Usage: bench-ca-threads [max threads, default: hardware concurrency] [size, default: 10240]
+	int max_threads_num = (argc > 1) ? atoi(argv[1]) : max(1u, thread::hardware_concurrency());
+	int size = (argc > 2) ? atoi(argv[2]) : 10240;
+
+	const int CHECK_HEIGHT = 1500;
+	const int CHECK_WIDTH = 1000;
+	const int CHECK_TURNS_NUM = 20;
+	LifeGrid single(CHECK_HEIGHT, CHECK_WIDTH, {3}, {2, 3});
+	soup(single, CHECK_HEIGHT, CHECK_WIDTH, 0.3, 1);
+	for (int t = 0; t < CHECK_TURNS_NUM; t++) {
+		single.turn();
+	}
+	for (int threads_num = 2; threads_num <= max_threads_num; threads_num++) {
+		LifeGrid multi(CHECK_HEIGHT, CHECK_WIDTH, {3}, {2, 3});
+		multi.set_threads_num(threads_num);
+		soup(multi, CHECK_HEIGHT, CHECK_WIDTH, 0.3, 1);
+		for (int t = 0; t < CHECK_TURNS_NUM; t++) {
+			multi.turn();
+		}
+		if (!same(single, multi, CHECK_HEIGHT, CHECK_WIDTH)) {
+			fprintf(stderr, "Mismatch with %d threads\n", threads_num);
+			exit(1);
+		}
+	}
+	printf("Check OK: 2..%d threads same as single\n", max_threads_num);
+
+	LifeGrid grid(size, size, {3}, {2, 3});
+	soup(grid, size, size, 0.3, 2);
+	printf("Kernel: %s, %dx%d\n", LifeGrid::kernel_name(), size, size);
+	printf("%8s %8s %12s %10s\n", "threads", "turns", "turns/s", "speedup");
+	double turns_per_sec_single = 0.0;
+	for (int threads_num = 1; threads_num <= max_threads_num; threads_num++) {
+		grid.set_threads_num(threads_num);
+		grid.turn(); // warm-up
+		int turns_num = 0;
+		int64_t t_start = time_musec();
+		int64_t t_elapsed = 0;
+		while ((turns_num < 4) || (t_elapsed < 1000000)) {
+			grid.turn();
+			turns_num++;
+			t_elapsed = time_musec() - t_start;
+		}
+		double turns_per_sec = 1e6 * turns_num / t_elapsed;
+		if (threads_num == 1) {
+			turns_per_sec_single = turns_per_sec;
+		}
+		printf("%8d %8d %12.1f %10.2f\n", grid.threads_num(), turns_num, turns_per_sec, turns_per_sec / turns_per_sec_single);
+		fflush(stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,147 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Benchmark: zone etales of demo (see zone.hpp), byte per cell ("zone") vs bit per cell ("zone2", run-length compressed
+ * by Efunguz): encode and decode time, and bytes on wire, measured by sending them over ipc, for zones of several sizes
+ * and kinds. Received zones are checked to be the same as sent ones
+ */
+
+#include "../bench/bench.hpp"
+#include "zone.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+
+bool same(const LifeGrid& a, const int ax0, const LifeGrid& b, const int bx0, const int zh, const int zw) {
+	for (int y = 0; y < zh; y++) {
+		for (int x = 0; x < zw; x++) {
+			if (a.get_cell(y, ax0 + x) != b.get_cell(y, bx0 + x)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+struct Result {
+	double encode_musec;
+	double decode_musec;
+	size_t bytes_num; // of parts
+	size_t wire_bytes_num; // of parts as emitted
+};
+
+
+Result measure(const LifeGrid& grid, const int x0, const int zh, const int zw, const bool bits, PubSub& ps, const Emyzelium::Etale& etale) {
+	const int REPEATS_NUM = max(4, (1 << 24) / (zh * zw));
+	const string& title = bits ? ZONE2_TITLE : ZONE_TITLE;
+	Result res;
+
+	int64_t t_start = time_nsec();
+	vector<vector<uint8_t>> parts;
+	for (int i = 0; i < REPEATS_NUM; i++) {
+		parts = zone_to_etale(grid, x0, zh, zw, bits);
+	}
+	res.encode_musec = 1e-3 * (time_nsec() - t_start) / REPEATS_NUM;
+	res.bytes_num = parts[0].size() + parts[1].size() + parts[2].size();
+
+	LifeGrid received(zh, zw, {3}, {2, 3});
+	t_start = time_nsec();
+	for (int i = 0; i < REPEATS_NUM; i++) {
+		etale_to_zone(parts, bits, received, zh, zw);
+	}
+	res.decode_musec = 1e-3 * (time_nsec() - t_start) / REPEATS_NUM;
+
+	uint64_t wire_bytes_num_start = ps.pub.emit_stats()[title].packed_bytes_num;
+	uint64_t msgs_num = etale.stats().msgs_num;
+	ps.pub.emit_etale(title, parts);
+	ps.receive(etale, msgs_num);
+	res.wire_bytes_num = ps.pub.emit_stats()[title].packed_bytes_num - wire_bytes_num_start;
+	LifeGrid wired(zh, zw, {3}, {2, 3});
+	if (!etale_to_zone(etale.parts(), bits, wired, zh, zw) || !same(grid, x0, wired, 0, zh, zw) || !same(grid, x0, received, 0, zh, zw)) {
+		fprintf(stderr, "Zone %dx%d received corrupted as %s\n", zh, zw, title.c_str());
+		exit(1);
+	}
+	return res;
+}
+
+
+int main() {
+	mt19937_64 rng(12345);
+
+	PubSub ps("zone");
+	ps.pub.set_emit_compression(ZONE2_TITLE, Emyzelium::Ecodec::Rle); // as in demo
+	const Emyzelium::Etale& zone = get<0>(ps.ehypha.add_etale(ZONE_TITLE));
+	const Emyzelium::Etale& zone2 = get<0>(ps.ehypha.add_etale(ZONE2_TITLE));
+	ps.join([&]() {
+		ps.pub.emit_etale(ZONE_TITLE, vector<vector<uint8_t>>{});
+		ps.pub.emit_etale(ZONE2_TITLE, vector<vector<uint8_t>>{});
+	}, [&]() { return (zone.t_in >= 0) && (zone2.t_in >= 0); });
+
+	printf("%28s %10s %10s %10s %10s %10s %10s %10s\n", "zone", "zone, B", "zone2, B", "wire, B", "enc, musec", "enc2, musec", "dec, musec", "dec2, musec");
+	struct Kind {
+		const char* name;
+		double density;
+		int settle_turns_num;
+	};
+	const int SIZES[][2] = {{96, 80}, {1024, 1024}}; // zone of realm in terminal, and of large one
+	for (const auto& size : SIZES) {
+		int zh = size[0];
+		int zw = size[1];
+		for (const Kind& kind : {Kind{"empty", 0.0, 0}, Kind{"soup 0.3, settled", 0.3, 200}, Kind{"noise 0.5", 0.5, 0}}) {
+			// Zone is right third of realm, as in demo
+			int w = 3 * zw + 1;
+			LifeGrid grid(zh, w, {3}, {2, 3});
+			uniform_real_distribution<double> uniform(0.0, 1.0);
+			for (int y = 0; y < zh; y++) {
+				for (int x = 0; x < w; x++) {
+					grid.set_cell(y, x, (uniform(rng) < kind.density) ? 1 : 0);
+				}
+			}
+			for (int t = 0; t < kind.settle_turns_num; t++) {
+				grid.turn();
+			}
+			Result bytes = measure(grid, w - zw, zh, zw, false, ps, zone);
+			Result bits = measure(grid, w - zw, zh, zw, true, ps, zone2);
+			string name = to_string(zh) + "x" + to_string(zw) + ", " + kind.name;
+			printf("%28s %10zu %10zu %10zu %10.2f %10.2f %10.2f %10.2f\n", name.c_str(), bytes.bytes_num, bits.bytes_num, bits.wire_bytes_num, bytes.encode_musec, bits.encode_musec, bytes.decode_musec, bits.decode_musec);
+			fflush(stdout);
+		}
+	}
+	printf("(wire: zone2 as emitted, run-length compressed whenever that is shorter; zone goes as it is)\n");
+
+	return 0;
+}
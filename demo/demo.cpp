@@ -35,6 +35,9 @@
  */
 
 #include "../emyzelium.hpp"
+#include "hashlife.hpp"
+#include "life.hpp"
+#include "zone.hpp"
 
 #include <algorithm>
 #include <cstdio>
@@ -185,6 +188,13 @@ void print_rect(int y, int x, int h, int w, int attr=0) {
 struct Other {
 	string name;
 	string publickey;
+	bool zone2; // its zone is received as ZONE2_TITLE, since it advertised that, see Realm_CA::negotiate_zones()
+	bool zone2_broken; // its zone2 once failed to decode, so zone is kept
+	int64_t titles_t_in; // of its "" etale when last negotiated
+
+	const string& zone_title() const {
+		return this->zone2 ? ZONE2_TITLE : ZONE_TITLE;
+	}
 };
 
 
@@ -193,25 +203,28 @@ class Realm_CA {
 	Emyzelium::Efunguz* efunguz;
 	int height;
 	int width;
-	vector<vector<uint8_t>> cells; // bits: 0 - current state, 1-4 - number of alive neighbours
+	LifeGrid grid;
+	LifeHash* hashlife; // if set, turns jump by it, grid being then view of its cells...
+	uint64_t hashlife_turns_num; // ...by so many turns at once
+	bool hashlife_stale; // cells were set in grid since last jump
 	set<int> birth;
 	set<int> survival;
 	double autoemit_interval;
 	int framerate;
 	vector<Other> others;
-	int i_turn;
+	int64_t i_turn;
 	int cursor_y;
 	int cursor_x;
 
 public:
 	Realm_CA(const string& name, const string& secretkey, const unordered_set<string>& whitelist_publickeys, const uint16_t pubport, const int height, const int width, const set<int>& birth, const set<int>& survival, const double autoemit_interval=4.0, const int framerate=30)
-	: name {name}, width {width}, birth {birth}, survival {survival}, autoemit_interval {autoemit_interval}, framerate {framerate} {
+	: name {name}, height {(height >> 1) << 1}, width {width}, grid {(height >> 1) << 1, width, birth, survival}, birth {birth}, survival {survival}, autoemit_interval {autoemit_interval}, framerate {framerate} {
 		this->efunguz = new Emyzelium::Efunguz(secretkey, whitelist_publickeys, pubport);
-		this->height = (height >> 1) << 1;
-
-		for (int y = 0; y < this->height; y++) {
-			this->cells.push_back(vector<uint8_t>(this->width));
-		}
+		this->efunguz->set_emit_compression(ZONE2_TITLE, Emyzelium::Ecodec::Rle); // receivers of zone2 are recent enough to decompress it
+		this->grid.set_threads_num(thread::hardware_concurrency()); // matters only for realms much larger than terminal
+		this->hashlife = nullptr;
+		this->hashlife_turns_num = 1;
+		this->hashlife_stale = false;
 
 		this->i_turn = 0;
 
@@ -220,11 +233,12 @@ public:
 	}
 
 
-	void add_other(const string& name, const string& publickey, const string& onion, const uint16_t port) {
-		auto& ehypha = get<0>(this->efunguz->add_ehypha(publickey, onion, port));
+	void add_other(const string& name, const string& publickey, const string& onion, const uint16_t port, const bool direct=false) {
+		// Direct: all realms on this PC, without Tor
+		auto& ehypha = direct ? *get<0>(this->efunguz->add_ehypha_direct(publickey, "tcp://127.0.0.1:" + to_string(port))) : get<0>(this->efunguz->add_ehypha(publickey, onion, port));
 		ehypha.add_etale("");
-		ehypha.add_etale("zone");
-		this->others.push_back(Other{name, publickey});
+		ehypha.add_etale(ZONE_TITLE);
+		this->others.push_back(Other{name, publickey, false, false, -1});
 	}
 
 
@@ -233,19 +247,29 @@ public:
 	}
 
 
+	// HashLife instead of dense grid, for jumps by many turns at once, or dense grid again if turns_num is 0
+	void set_hashlife(const uint64_t turns_num) {
+		delete this->hashlife;
+		this->hashlife = nullptr;
+		if (turns_num > 0) {
+			this->hashlife = new LifeHash(this->height, this->width, this->birth, this->survival);
+			this->hashlife_turns_num = turns_num;
+			this->hashlife_stale = true;
+		}
+	}
+
+
 	void flip(const int y=-1, const int x=-1) {
 		int fy = (y < 0) ? this->cursor_y : y;
 		int fx = (x < 0) ? this->cursor_x : x;
-		this->cells[fy][fx] ^= 1;
+		this->grid.flip_cell(fy, fx);
+		this->hashlife_stale = true;
 	}
 
 
 	void clear() {
-		for (int y = 0; y < this->height; y++) {
-			for (int x = 0; x < this->width; x++) {
-				this->cells[y][x] = 0;
-			}
-		}
+		this->grid.clear();
+		this->hashlife_stale = true;
 		this->i_turn = 0;
 	}
 
@@ -254,9 +278,10 @@ public:
 		mt19937_64 mt_engine(time_musec());
 		for (int y = 0; y < this->height; y++) {
 			for (int x = 0; x < this->width; x++) {
-				this->cells[y][x] = mt_engine() & 1;
+				this->grid.set_cell(y, x, mt_engine() & 1);
 			}
 		}
+		this->hashlife_stale = true;
 		this->i_turn = 0;
 	}
 
@@ -280,7 +305,7 @@ public:
 			int y = i << 1;
 			string row_str = "";
 			for (int x = 0; x < w; x++) {
-				row_str += cell_chars[this->cells[y + 1][x] & 1][this->cells[y][x] & 1];				
+				row_str += cell_chars[this->grid.get_cell(y + 1, x)][this->grid.get_cell(y, x)];				
 			}
 			mvaddstrattr(1 + i, 1, row_str, COLOR_PAIR(7) | A_BOLD); // white on black
 		}
@@ -290,8 +315,8 @@ public:
 		if (show_cursor) {
 			int i = this->cursor_y >> 1;
 			int m = this->cursor_y & 1;
-			int cell_high = this->cells[i << 1][this->cursor_x] & 1;
-			int cell_low = this->cells[(i << 1) + 1][this->cursor_x] & 1;
+			int cell_high = this->grid.get_cell(i << 1, this->cursor_x);
+			int cell_low = this->grid.get_cell((i << 1) + 1, this->cursor_x);
 
 			vector<vector<vector<string>>> chars = {{{"▀",      "▄"},      {"▀",      "▀"}},      {{"▄",      "▄"},      {"▄",      "▀"}}};
 			vector<vector<vector<int>>>    clrps = {{{1|(0<<3), 1|(0<<3)}, {3|(0<<3), 7|(1<<3)}}, {{7|(1<<3), 3|(0<<3)}, {7|(3<<3), 7|(3<<3)}}};
@@ -304,7 +329,7 @@ public:
 
 			mvaddstrattr(1 + i, 1 + this->cursor_x, s_char, COLOR_PAIR(s_clrp) | (s_bold * A_BOLD));
 
-			status_str += ", X = " + to_string(this->cursor_x) + ", Y = " + to_string(this->cursor_y) + ", C = " + to_string(this->cells[this->cursor_y][this->cursor_x] & 1);
+			status_str += ", X = " + to_string(this->cursor_x) + ", Y = " + to_string(this->cursor_y) + ", C = " + to_string(this->grid.get_cell(this->cursor_y, this->cursor_x));
 		}
 
 		status_str += " ]";
@@ -319,92 +344,84 @@ public:
 
 
 	void turn() {
-		// Not much optimization...
-		int h = this->height;
-		int w = this->width;
-		// Count alive neighbours
-		for (int y = 0; y < h; y++) {
-			for (int x = 0; x < w; x++) {
-				if (this->cells[y][x] & 1) { // increment number of neighbours for all neighbouring cells
-					for (int ny = y - 1; ny <= y + 1; ny++) {
-						if ((ny >= 0) && (ny < h)) {
-							for (int nx = x - 1; nx <= x + 1; nx++) {
-								if (((ny != y) || (nx != x)) && (nx >= 0) && (nx < w)) {
-									this->cells[ny][nx] += 2;
-								}
-							}
-						}
-					}
-				}
-			}
-		}
-		// Update
-		for (int y = 0; y < h; y++) {
-			for (int x = 0; x < w; x++) {
-				uint8_t c = this->cells[y][x];
-				if (c & 1) {
-					c = this->survival.count(c >> 1);
-				} else {
-					c = this->birth.count(c >> 1);
-				}
-				this->cells[y][x] = c;
+		if (this->hashlife != nullptr) {
+			if (this->hashlife_stale) {
+				this->hashlife->import_from(this->grid);
+				this->hashlife_stale = false;
 			}
+			this->hashlife->jump(this->hashlife_turns_num);
+			this->hashlife->export_to(this->grid);
+			this->i_turn += this->hashlife_turns_num;
+		} else {
+			this->grid.turn();
+			this->i_turn++;
 		}
-		this->i_turn++;
 	}
 
 
-	vector<vector<uint8_t>> get_etale_from_zone() {
-		vector<vector<uint8_t>> parts;
-		int h = this->height;
-		int w = this->width;
-		int zh = h;
-		int zw = w / 3;
-
-		parts.emplace_back(2);
-		memcpy(parts[0].data(), &zh, 2);
+	vector<vector<uint8_t>> get_etale_from_zone(const bool bits=false) {
+		int zw = this->width / 3;
+		return zone_to_etale(this->grid, this->width - zw, this->height, zw, bits);
+	}
 
-		parts.emplace_back(2);
-		memcpy(parts[1].data(), &zw, 2);
 
-		parts.emplace_back(zh * zw);
-		for (int y = 0; y < zh; y++) {
-			for (int x = 0; x < zw; x++) {
-				parts[2][y * zw + x] = this->cells[y][w - zw + x] & 1; // could compress to bits...
-			}
+	bool put_etale_to_zone(const vector<vector<uint8_t>>& parts, const bool bits=false) {
+		if (!etale_to_zone(parts, bits, this->grid, this->height, this->width / 3)) {
+			return false;
 		}
+		this->hashlife_stale = true;
+		return true;
+	}
+
 
-		return parts;
+	void emit_etales() {
+		this->efunguz->emit_etale("", {str_to_vec_u8(ZONE_TITLE), str_to_vec_u8(ZONE_DESCRIPTION), str_to_vec_u8(ZONE2_TITLE), str_to_vec_u8(ZONE2_DESCRIPTION)});
+		// Each format only if someone subscribes to it, i.e. zone by older peers or by those that have not received our "" etale yet
+		if (this->efunguz->subscriptions_num(ZONE_TITLE) > 0) { // no one to receive it, no need to make it
+			this->efunguz->emit_etale(ZONE_TITLE, this->get_etale_from_zone(false));
+		}
+		if (this->efunguz->subscriptions_num(ZONE2_TITLE) > 0) {
+			this->efunguz->emit_etale(ZONE2_TITLE, this->get_etale_from_zone(true));
+		}
 	}
 
 
-	void put_etale_to_zone(const vector<vector<uint8_t>>& parts) {
-		if (parts.size() == 3) {
-			if ((parts[0].size() == 2) && (parts[1].size() == 2)) {
-				int szh = *((uint16_t *)parts[0].data());
-				int szw = *((uint16_t *)parts[1].data());
-				if (parts[2].size() == szh * szw) {
-					int dzh = min(szh, this->height);
-					int dzw = min(szw, this->width / 3);
-					for (int y = 0; y < dzh; y++) {
-						for (int x = 0; x < dzw; x++) {
-							this->cells[y][x] = parts[2][y * szw + x] & 1;
-						}
-					}
+	// Receive zone2 of other realm while its "" etale lists that title, zone once it does not; older ones send zone only.
+	// Titles are looked at only when "" etale has been updated
+	void negotiate_zones() {
+		static const vector<uint8_t> zone2_title = str_to_vec_u8(ZONE2_TITLE);
+		for (auto& that : this->others) {
+			const auto* titles_etale = get<0>(get<0>(this->efunguz->get_ehypha_ptr(that.publickey))->get_etale_ptr(""));
+			if (titles_etale->t_in == that.titles_t_in) {
+				continue;
+			}
+			that.titles_t_in = titles_etale->t_in;
+			const auto& titles = titles_etale->parts();
+			bool zone2 = false;
+			for (size_t i = 0; i < titles.size(); i += 2) {
+				if (titles[i] == zone2_title) {
+					zone2 = true;
+					break;
 				}
 			}
+			this->switch_zone(that, zone2 && !that.zone2_broken);
 		}
 	}
 
 
-	void emit_etales() {
-		this->efunguz->emit_etale("", {str_to_vec_u8("zone"), str_to_vec_u8("2B height (h), 2B width (w), h×wB zone by rows")});
-		this->efunguz->emit_etale("zone", this->get_etale_from_zone());
+	void switch_zone(Other& that, const bool zone2) {
+		if (zone2 == that.zone2) {
+			return;
+		}
+		auto& ehypha = *get<0>(this->efunguz->get_ehypha_ptr(that.publickey));
+		ehypha.add_etale(zone2 ? ZONE2_TITLE : ZONE_TITLE);
+		ehypha.del_etale(that.zone_title());
+		that.zone2 = zone2;
 	}
 
 
-	void update_efunguz() {
-		this->efunguz->update();
+	void update_efunguz(const long timeout_ms=0) {
+		this->efunguz->wait_update(timeout_ms);
 	}
 
 
@@ -437,7 +454,7 @@ public:
 				mvaddstrattr((h >> 1) + 3, 0, "Other realms: ");
 				for (int i_other = 0; i_other < this->others.size(); i_other++) {
 					const auto& that = this->others[i_other];
-					addstrattr((i_other > 0 ? string(", ") : string("")) + "[" + to_string(i_other + 1) + "] \"" + that.name + "'s\" (SLU " + to_str(t - 1e-6 * (get<0>(get<0>(this->efunguz->get_ehypha_ptr(that.publickey))->get_etale_ptr("zone"))->t_in - t_start), 1) + ")");
+					addstrattr((i_other > 0 ? string(", ") : string("")) + "[" + to_string(i_other + 1) + "] \"" + that.name + "'s\" (SLU " + to_str(t - 1e-6 * (get<0>(get<0>(this->efunguz->get_ehypha_ptr(that.publickey))->get_etale_ptr(that.zone_title()))->t_in - t_start), 1) + ")");
 				}
 				mvaddstrattr(LINES - 3, 0, "[Q] quit, [C] clear, [R] reset, [V] render on/off, [P] pause/resume");
 				mvaddstrattr(LINES - 2, 0, "[A] autoemit on/off, [E] emit, [1-9] import");
@@ -453,7 +470,9 @@ public:
 				t_last_emit = t;
 			}
 
-			this->update_efunguz();
+			// While paused, nothing else to do until next render, so sleep in wait for incoming data instead of spinning
+			this->update_efunguz(paused ? (1000 / this->framerate) : 0);
+			this->negotiate_zones();
 
 			if (!paused) {
 				this->turn();
@@ -487,8 +506,12 @@ public:
 				case '1'...'9':
 					int i_other = ch - '1';
 					if (i_other < this->others.size()) {
-						const auto* that_zone = get<0>(get<0>(this->efunguz->get_ehypha_ptr(this->others[i_other].publickey))->get_etale_ptr("zone"));
-						this->put_etale_to_zone(that_zone->parts);
+						auto& that = this->others[i_other];
+						const auto* that_zone = get<0>(get<0>(this->efunguz->get_ehypha_ptr(that.publickey))->get_etale_ptr(that.zone_title()));
+						if (!this->put_etale_to_zone(that_zone->parts(), that.zone2) && that.zone2 && (that_zone->t_in >= 0)) {
+							that.zone2_broken = true; // zone arrives with next emission of that realm
+							this->switch_zone(that, false);
+						}
 					}
 					break;
 			}
@@ -519,12 +542,13 @@ public:
 
 
 	~Realm_CA() {
+		delete this->hashlife;
 		delete this->efunguz;
 	}
 };
 
 
-int run_realm(string name) {
+int run_realm(string name, const bool direct, const uint64_t hashlife_turns_num) {
 	string name_up = name;
 	transform(name_up.begin(), name_up.end(), name_up.begin(), ::toupper);
 
@@ -595,8 +619,10 @@ int run_realm(string name) {
 	// Uncomment to restrict: Alien gets data from John and Mary; John gets data from Alien but not from Mary; Mary gets data from neither Alien, nor John
 	// realm.add_whitelist_publickeys({that1_publickey});
 
-	realm.add_other(that1_name, that1_publickey, that1_onion, that1_port);
-	realm.add_other(that2_name, that2_publickey, that2_onion, that2_port);
+	realm.add_other(that1_name, that1_publickey, that1_onion, that1_port, direct);
+	realm.add_other(that2_name, that2_publickey, that2_onion, that2_port, direct);
+
+	realm.set_hashlife(hashlife_turns_num);
 
 	realm.reset();
 
@@ -611,7 +637,7 @@ int run_realm(string name) {
 int main(int argc, char** argv) {
 	if (argc < 2) {
 		printf("Syntax:\n");
-		printf("demo <Alien|John|Mary>\n");
+		printf("demo <Alien|John|Mary> [direct] [hashlife <turns per turn>]\n");
 		return (-1);
 	}
 
@@ -620,5 +646,15 @@ int main(int argc, char** argv) {
 		args.emplace_back(argv[i]);
 	}
 
-	return run_realm(args[1]);
+	bool direct = false;
+	uint64_t hashlife_turns_num = 0;
+	for (size_t i = 2; i < args.size(); i++) {
+		if (args[i] == "direct") {
+			direct = true;
+		} else if ((args[i] == "hashlife") && (i + 1 < args.size())) {
+			hashlife_turns_num = stoull(args[++i]);
+		}
+	}
+
+	return run_realm(args[1], direct, hashlife_turns_num);
 }
@@ -0,0 +1,329 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * HashLife for LifeGrid of life.hpp: memoised quadtree that jumps by powers of 2 of turns at once
+ */
+
+#ifndef EMYZELIUM_DEMO_HASHLIFE_HPP
+#define EMYZELIUM_DEMO_HASHLIFE_HPP
+
+
+#include "life.hpp"
+
+#include <limits>
+#include <unordered_map>
+
+
+// Leaves, i.e. nodes of level 0. Cells beyond grid are void: never alive, not counted as neighbours, so that jumps
+// give exactly what LifeGrid::turn() would, with dead outside, for any B/S rule
+const uint32_t HASHLIFE_DEAD = 0;
+const uint32_t HASHLIFE_ALIVE = 1;
+const uint32_t HASHLIFE_VOID = 2;
+
+const size_t HASHLIFE_NODES_LIMIT = size_t(1) << 22; // beyond it, nodes unreachable from root are dropped, with their memo
+const uint32_t HASHLIFE_NO_NODE = numeric_limits<uint32_t>::max();
+
+
+struct HashNode {
+	uint32_t nw; // quadrants of level - 1
+	uint32_t ne;
+	uint32_t sw;
+	uint32_t se;
+	uint32_t result; // memo: centre, of level - 1, advanced by 2^result_j turns
+	int8_t level; // i.e. 2^level x 2^level cells
+	int8_t result_j; // -1 if none
+	uint64_t population;
+};
+
+
+inline uint64_t hash_quadrants(const uint32_t nw, const uint32_t ne, const uint32_t sw, const uint32_t se) {
+	uint64_t h = ((uint64_t(nw) << 32) | ne) * 0x9E3779B97F4A7C15ULL;
+	h ^= (((uint64_t(sw) << 32) | se) + (h >> 29)) * 0xC2B2AE3D27D4EB4FULL;
+	return h ^ (h >> 32);
+}
+
+
+// Grid lies in root of level root_level, at (2^(root_level - 2), 2^(root_level - 2)), i.e. within its centre, surrounded by void;
+// centre advanced by up to 2^(root_level - 2) turns then holds entire grid, and is surrounded by void again
+class LifeHash {
+	int height;
+	int width;
+	uint8_t rule[9]; // as of LifeGrid
+	vector<HashNode> nodes;
+	vector<uint32_t> slots; // open addressing, linear probing: node by its quadrants, or HASHLIFE_NO_NODE; at most half full
+	vector<uint32_t> void_nodes; // by level
+	uint32_t root;
+	int root_level;
+
+	void init_nodes() {
+		this->nodes.clear();
+		this->slots.assign(size_t(1) << 16, HASHLIFE_NO_NODE);
+		for (uint32_t leaf : {HASHLIFE_DEAD, HASHLIFE_ALIVE, HASHLIFE_VOID}) {
+			this->nodes.push_back(HashNode{0, 0, 0, 0, 0, 0, -1, (leaf == HASHLIFE_ALIVE) ? uint64_t(1) : uint64_t(0)});
+		}
+		this->void_nodes.assign(1, HASHLIFE_VOID);
+		for (int level = 1; level <= this->root_level; level++) {
+			uint32_t v = this->void_nodes.back();
+			this->void_nodes.push_back(this->join(v, v, v, v));
+		}
+	}
+
+	void grow_slots() {
+		this->slots.assign(this->slots.size() << 1, HASHLIFE_NO_NODE);
+		size_t mask = this->slots.size() - 1;
+		for (uint32_t n = HASHLIFE_VOID + 1; n < this->nodes.size(); n++) {
+			const HashNode& node = this->nodes[n];
+			size_t i = hash_quadrants(node.nw, node.ne, node.sw, node.se) & mask;
+			while (this->slots[i] != HASHLIFE_NO_NODE) {
+				i = (i + 1) & mask;
+			}
+			this->slots[i] = n;
+		}
+	}
+
+	// The only node of these quadrants
+	uint32_t join(const uint32_t nw, const uint32_t ne, const uint32_t sw, const uint32_t se) {
+		size_t mask = this->slots.size() - 1;
+		size_t i = hash_quadrants(nw, ne, sw, se) & mask;
+		uint32_t n;
+		while ((n = this->slots[i]) != HASHLIFE_NO_NODE) {
+			const HashNode& node = this->nodes[n];
+			if ((node.nw == nw) && (node.ne == ne) && (node.sw == sw) && (node.se == se)) {
+				return n;
+			}
+			i = (i + 1) & mask;
+		}
+		n = this->nodes.size();
+		uint64_t population = this->nodes[nw].population + this->nodes[ne].population + this->nodes[sw].population + this->nodes[se].population;
+		this->nodes.push_back(HashNode{nw, ne, sw, se, 0, int8_t(this->nodes[nw].level + 1), -1, population});
+		this->slots[i] = n;
+		if (2 * this->nodes.size() > this->slots.size()) {
+			this->grow_slots();
+		}
+		return n;
+	}
+
+	uint32_t centre(const uint32_t n) {
+		HashNode node = this->nodes[n];
+		return this->join(this->nodes[node.nw].se, this->nodes[node.ne].sw, this->nodes[node.sw].ne, this->nodes[node.se].nw);
+	}
+
+	// Leaf of node of level 2
+	uint32_t leaf(const uint32_t n, const int y, const int x) const {
+		const HashNode& node = this->nodes[n];
+		const HashNode& quad = this->nodes[(y < 2) ? ((x < 2) ? node.nw : node.ne) : ((x < 2) ? node.sw : node.se)];
+		return (y & 1) ? ((x & 1) ? quad.se : quad.sw) : ((x & 1) ? quad.ne : quad.nw);
+	}
+
+	// Centre 2x2 of node of level 2, advanced by 1 turn
+	uint32_t advance_base(const uint32_t n) {
+		uint32_t next[2][2];
+		for (int y = 1; y <= 2; y++) {
+			for (int x = 1; x <= 2; x++) {
+				uint32_t c = this->leaf(n, y, x);
+				if (c == HASHLIFE_VOID) {
+					next[y - 1][x - 1] = c;
+					continue;
+				}
+				int alive_num = 0;
+				for (int dy = -1; dy <= 1; dy++) {
+					for (int dx = -1; dx <= 1; dx++) {
+						if (((dy != 0) || (dx != 0)) && (this->leaf(n, y + dy, x + dx) == HASHLIFE_ALIVE)) {
+							alive_num++;
+						}
+					}
+				}
+				next[y - 1][x - 1] = (this->rule[alive_num] & ((c == HASHLIFE_ALIVE) ? 2 : 1)) ? HASHLIFE_ALIVE : HASHLIFE_DEAD;
+			}
+		}
+		return this->join(next[0][0], next[0][1], next[1][0], next[1][1]);
+	}
+
+	// Centre of node of level k >= 2, advanced by 2^j turns, j <= k - 2
+	uint32_t advance(const uint32_t n, const int j) {
+		if (this->nodes[n].result_j == j) {
+			return this->nodes[n].result;
+		}
+		int k = this->nodes[n].level;
+		uint32_t r;
+		if (k == 2) {
+			r = this->advance_base(n);
+		} else {
+			HashNode node = this->nodes[n];
+			HashNode nw = this->nodes[node.nw];
+			HashNode ne = this->nodes[node.ne];
+			HashNode sw = this->nodes[node.sw];
+			HashNode se = this->nodes[node.se];
+			// 9 overlapping subnodes of level k - 1, by rows
+			uint32_t sub[3][3] = {
+				{node.nw, this->join(nw.ne, ne.nw, nw.se, ne.sw), node.ne},
+				{this->join(nw.sw, nw.se, sw.nw, sw.ne), this->join(nw.se, ne.sw, sw.ne, se.nw), this->join(ne.sw, ne.se, se.nw, se.ne)},
+				{node.sw, this->join(sw.ne, se.nw, sw.se, se.sw), node.se}
+			};
+			// Full jump: both halves advance by 2^(k - 3); shorter one: only second half advances
+			bool full = j == k - 2;
+			int jj = full ? (j - 1) : j;
+			for (int a = 0; a < 3; a++) {
+				for (int b = 0; b < 3; b++) {
+					sub[a][b] = full ? this->advance(sub[a][b], jj) : this->centre(sub[a][b]);
+				}
+			}
+			uint32_t q[2][2];
+			for (int a = 0; a < 2; a++) {
+				for (int b = 0; b < 2; b++) {
+					q[a][b] = this->advance(this->join(sub[a][b], sub[a][b + 1], sub[a + 1][b], sub[a + 1][b + 1]), jj);
+				}
+			}
+			r = this->join(q[0][0], q[0][1], q[1][0], q[1][1]);
+		}
+		this->nodes[n].result = r;
+		this->nodes[n].result_j = j;
+		return r;
+	}
+
+	// Node of level root_level - 1 as centre of new root, in void
+	uint32_t embed(const uint32_t c) {
+		HashNode node = this->nodes[c];
+		uint32_t v = this->void_nodes[this->root_level - 2];
+		return this->join(this->join(v, v, v, node.nw), this->join(v, v, node.ne, v), this->join(v, node.sw, v, v), this->join(node.se, v, v, v));
+	}
+
+	uint32_t copy_into(LifeHash& other, const uint32_t n, unordered_map<uint32_t, uint32_t>& copies) const {
+		if (n <= HASHLIFE_VOID) {
+			return n;
+		}
+		auto it = copies.find(n);
+		if (it != copies.end()) {
+			return it->second;
+		}
+		const HashNode& node = this->nodes[n];
+		uint32_t m = other.join(this->copy_into(other, node.nw, copies), this->copy_into(other, node.ne, copies), this->copy_into(other, node.sw, copies), this->copy_into(other, node.se, copies));
+		copies.emplace(n, m);
+		return m;
+	}
+
+	void collect() {
+		LifeHash live(this->height, this->width, set<int>{}, set<int>{});
+		unordered_map<uint32_t, uint32_t> copies;
+		live.root = this->copy_into(live, this->root, copies);
+		swap(this->nodes, live.nodes);
+		swap(this->slots, live.slots);
+		swap(this->void_nodes, live.void_nodes);
+		this->root = live.root;
+	}
+
+	// Node of given level at (y, x) of root, from grid
+	uint32_t build(const LifeGrid& grid, const int level, const int y, const int x) {
+		int offset = 1 << (this->root_level - 2);
+		int gy = y - offset;
+		int gx = x - offset;
+		int size = 1 << level;
+		if ((gy >= this->height) || (gx >= this->width) || (gy + size <= 0) || (gx + size <= 0)) {
+			return this->void_nodes[level];
+		}
+		if (level == 0) {
+			return grid.get_cell(gy, gx) ? HASHLIFE_ALIVE : HASHLIFE_DEAD;
+		}
+		int half = size >> 1;
+		return this->join(this->build(grid, level - 1, y, x), this->build(grid, level - 1, y, x + half), this->build(grid, level - 1, y + half, x), this->build(grid, level - 1, y + half, x + half));
+	}
+
+	void write(LifeGrid& grid, const uint32_t n, const int y, const int x) const {
+		const HashNode& node = this->nodes[n];
+		if (node.population == 0) {
+			return;
+		}
+		if (node.level == 0) {
+			int offset = 1 << (this->root_level - 2);
+			grid.set_cell(y - offset, x - offset, 1);
+			return;
+		}
+		int half = 1 << (node.level - 1);
+		this->write(grid, node.nw, y, x);
+		this->write(grid, node.ne, y, x + half);
+		this->write(grid, node.sw, y + half, x);
+		this->write(grid, node.se, y + half, x + half);
+	}
+
+public:
+	LifeHash(const int height, const int width, const set<int>& birth, const set<int>& survival)
+	: height {height}, width {width} {
+		for (int n = 0; n <= 8; n++) {
+			this->rule[n] = (birth.count(n) ? 1 : 0) | (survival.count(n) ? 2 : 0);
+		}
+		this->root_level = 2;
+		while ((1 << (this->root_level - 1)) < max(height, width)) {
+			this->root_level++;
+		}
+		this->init_nodes();
+		this->root = this->void_nodes[this->root_level];
+	}
+
+	// Cells from grid of the same size, e.g. after they were set there
+	void import_from(const LifeGrid& grid) {
+		this->root = this->build(grid, this->root_level, 0, 0);
+	}
+
+	// Cells to grid of the same size, whose tiles then count as changed
+	void export_to(LifeGrid& grid) const {
+		grid.clear();
+		this->write(grid, this->root, 0, 0);
+	}
+
+	// Same as so many LifeGrid::turn()s. Jumps by 2^(root_level - 2) turns, then by powers of 2 of the rest;
+	// memo of each is kept while the power stays the same, so periodic or still grid costs single lookup per jump
+	void jump(const uint64_t turns_num) {
+		int j_max = this->root_level - 2;
+		for (int j = 63; j >= 0; j--) {
+			uint64_t jumps_num = (j == j_max) ? (turns_num >> j) : ((j < j_max) ? ((turns_num >> j) & 1) : 0);
+			for (uint64_t i = 0; i < jumps_num; i++) {
+				if (this->nodes.size() > HASHLIFE_NODES_LIMIT) {
+					this->collect();
+				}
+				this->root = this->embed(this->advance(this->root, j));
+			}
+		}
+	}
+
+	uint64_t population() const {
+		return this->nodes[this->root].population;
+	}
+
+	size_t nodes_num() const {
+		return this->nodes.size();
+	}
+};
+
+
+#endif
@@ -0,0 +1,454 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Life-like cellular automaton (any B/S rule, dead outside) on bit-packed grid, for demo
+ */
+
+#ifndef EMYZELIUM_DEMO_LIFE_HPP
+#define EMYZELIUM_DEMO_LIFE_HPP
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+using namespace std;
+
+
+// Bitwise operations on words, 1 at a time or several in SIMD register, for kernel of LifeGrid::turn()
+
+struct LanesScalar {
+	typedef uint64_t V;
+	static const int WORDS = 1;
+	static V load(const uint64_t* p) { return *p; }
+	static void store(uint64_t* p, const V v) { *p = v; }
+	static V zero() { return 0; }
+	static V ones() { return ~uint64_t(0); }
+	static V and_(const V a, const V b) { return a & b; }
+	static V or_(const V a, const V b) { return a | b; }
+	static V xor_(const V a, const V b) { return a ^ b; }
+	static V andnot(const V a, const V b) { return ~a & b; }
+	static V shl1(const V v) { return v << 1; }
+	static V shr1(const V v) { return v >> 1; }
+	static V shl63(const V v) { return v << 63; }
+	static V shr63(const V v) { return v >> 63; }
+};
+
+
+#if defined(__SSE2__)
+struct LanesSse2 {
+	typedef __m128i V;
+	static const int WORDS = 2;
+	static V load(const uint64_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static void store(uint64_t* p, const V v) { _mm_storeu_si128((__m128i*)p, v); }
+	static V zero() { return _mm_setzero_si128(); }
+	static V ones() { return _mm_set1_epi32(-1); }
+	static V and_(const V a, const V b) { return _mm_and_si128(a, b); }
+	static V or_(const V a, const V b) { return _mm_or_si128(a, b); }
+	static V xor_(const V a, const V b) { return _mm_xor_si128(a, b); }
+	static V andnot(const V a, const V b) { return _mm_andnot_si128(a, b); }
+	static V shl1(const V v) { return _mm_slli_epi64(v, 1); }
+	static V shr1(const V v) { return _mm_srli_epi64(v, 1); }
+	static V shl63(const V v) { return _mm_slli_epi64(v, 63); }
+	static V shr63(const V v) { return _mm_srli_epi64(v, 63); }
+};
+#endif
+
+
+#if defined(__AVX2__)
+struct LanesAvx2 {
+	typedef __m256i V;
+	static const int WORDS = 4;
+	static V load(const uint64_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static void store(uint64_t* p, const V v) { _mm256_storeu_si256((__m256i*)p, v); }
+	static V zero() { return _mm256_setzero_si256(); }
+	static V ones() { return _mm256_set1_epi32(-1); }
+	static V and_(const V a, const V b) { return _mm256_and_si256(a, b); }
+	static V or_(const V a, const V b) { return _mm256_or_si256(a, b); }
+	static V xor_(const V a, const V b) { return _mm256_xor_si256(a, b); }
+	static V andnot(const V a, const V b) { return _mm256_andnot_si256(a, b); }
+	static V shl1(const V v) { return _mm256_slli_epi64(v, 1); }
+	static V shr1(const V v) { return _mm256_srli_epi64(v, 1); }
+	static V shl63(const V v) { return _mm256_slli_epi64(v, 63); }
+	static V shr63(const V v) { return _mm256_srli_epi64(v, 63); }
+};
+#endif
+
+
+const int LIFE_TILE_ROWS = 16;
+const int LIFE_TILE_WORDS = 8; // i.e. tile is of 16x512 cells
+const int LIFE_BAND_WORDS = 1 << 14; // per band of rows of tiles turned at once by one thread, to stay in cache
+
+
+// Cells as bits, 64 per word, bit k of word i of row being cell 64i+k. Each row has zero word before and after it,
+// and there are zero rows above and below, so that neighbours of any word can be loaded without bounds checks.
+// Turn reads words and writes next_words, so bands of rows can be turned by several threads at once.
+// Tile that did not change in last turn, nor did its 8 neighbours, cannot change in this one, so it is skipped:
+// its words are then the same in both buffers
+class LifeGrid {
+	int height;
+	int width;
+	int words_num; // per row, w/o padding
+	int stride; // words_num + 2
+	uint64_t tail_mask; // of cells of last word of each row
+	vector<uint64_t> words;
+	vector<uint64_t> next_words;
+	uint8_t rule[9]; // by number of alive neighbours: bit 0 - birth, bit 1 - survival
+	int tiles_height;
+	int tiles_width;
+	vector<uint8_t> tiles_changed; // in last turn or since it, by rows of tiles, with zero border as of words
+	vector<uint8_t> next_tiles_changed;
+	bool tiles_skipping;
+	atomic<int> last_active_tiles_num; // turned in last turn
+	int band_tile_rows;
+	int bands_num;
+	atomic<int> next_band; // claimed by threads one by one, so that faster ones take more bands
+	vector<thread> workers; // persistent, turn bands along with caller of turn()
+	mutex pool_mutex;
+	condition_variable pool_cv; // workers wait here for next turn...
+	condition_variable pool_done_cv; // ...and caller of turn() for workers to finish it
+	uint64_t pool_turn; // number of turns started with workers
+	int pool_busy; // workers that have not finished current turn yet
+	bool pool_quit;
+
+	// Full adder of 3 bits in each position
+	template <typename L>
+	static void add3(const typename L::V a, const typename L::V b, const typename L::V c, typename L::V& sum, typename L::V& carry) {
+		typename L::V ab = L::xor_(a, b);
+		sum = L::xor_(ab, c);
+		carry = L::or_(L::and_(a, b), L::and_(ab, c));
+	}
+
+	// Next state of L::WORDS words at p, rows above and below being at p -/+ stride
+	template <typename L>
+	typename L::V next(const uint64_t* p) const {
+		typedef typename L::V V;
+		const uint64_t* rows[3] = {p - this->stride, p, p + this->stride};
+		V w[3], c[3], e[3]; // west, this and east neighbours of each cell, in rows above, same and below
+		for (int r = 0; r < 3; r++) {
+			c[r] = L::load(rows[r]);
+			w[r] = L::or_(L::shl1(c[r]), L::shr63(L::load(rows[r] - 1)));
+			e[r] = L::or_(L::shr1(c[r]), L::shl63(L::load(rows[r] + 1)));
+		}
+		// Bit-sliced count of 8 neighbours, s0 + 2*s1 + 4*s2 + 8*s3, by adder tree
+		V u0, u1, d0, d1, s0, k1, t0, c1;
+		add3<L>(w[0], c[0], e[0], u0, u1);
+		add3<L>(w[2], c[2], e[2], d0, d1);
+		V m0 = L::xor_(w[1], e[1]);
+		V m1 = L::and_(w[1], e[1]);
+		add3<L>(u0, d0, m0, s0, k1);
+		add3<L>(u1, d1, m1, t0, c1);
+		V s1 = L::xor_(t0, k1);
+		V c2 = L::and_(t0, k1);
+		V s2 = L::xor_(c1, c2);
+		V s3 = L::and_(c1, c2);
+		const V s[4] = {s0, s1, s2, s3};
+
+		V alive = c[1];
+		V res = L::zero();
+		for (int n = 0; n <= 8; n++) {
+			if (this->rule[n] == 0) {
+				continue;
+			}
+			V eq = L::ones();
+			for (int k = 0; k < 4; k++) {
+				eq = ((n >> k) & 1) ? L::and_(eq, s[k]) : L::andnot(s[k], eq);
+			}
+			switch (this->rule[n]) {
+				case 1:
+					res = L::or_(res, L::andnot(alive, eq));
+					break;
+				case 2:
+					res = L::or_(res, L::and_(alive, eq));
+					break;
+				default:
+					res = L::or_(res, eq);
+			}
+		}
+		return res;
+	}
+
+	template <typename L>
+	void turn_words(const uint64_t* p, uint64_t* q, int& i, const int i_end) const {
+		for (; i + L::WORDS <= i_end; i += L::WORDS) {
+			L::store(q + i, this->next<L>(p + i));
+		}
+	}
+
+	// Whether any cell of tile changed
+	bool turn_tile(const int ty, const int tx) {
+		int y_end = min(this->height, (ty + 1) * LIFE_TILE_ROWS);
+		int i_begin = tx * LIFE_TILE_WORDS;
+		int i_end = min(this->words_num, i_begin + LIFE_TILE_WORDS);
+		uint64_t diff = 0;
+		for (int y = ty * LIFE_TILE_ROWS; y < y_end; y++) {
+			const uint64_t* p = this->words.data() + (y + 1) * this->stride + 1;
+			uint64_t* q = this->next_words.data() + (y + 1) * this->stride + 1;
+			int i = i_begin;
+#if defined(__AVX2__)
+			this->turn_words<LanesAvx2>(p, q, i, i_end);
+#elif defined(__SSE2__)
+			this->turn_words<LanesSse2>(p, q, i, i_end);
+#endif
+			this->turn_words<LanesScalar>(p, q, i, i_end);
+			if (i_end == this->words_num) { // cells beyond width must stay dead, e.g. under B0
+				q[i_end - 1] &= this->tail_mask;
+			}
+			for (i = i_begin; i < i_end; i++) {
+				diff |= p[i] ^ q[i];
+			}
+		}
+		return diff != 0;
+	}
+
+	int tile_index(const int ty, const int tx) const {
+		return (ty + 1) * (this->tiles_width + 2) + tx + 1;
+	}
+
+	void turn_tile_rows(const int ty_begin, const int ty_end) {
+		int active_num = 0;
+		for (int ty = ty_begin; ty < ty_end; ty++) {
+			for (int tx = 0; tx < this->tiles_width; tx++) {
+				int t = this->tile_index(ty, tx);
+				bool active = !this->tiles_skipping;
+				for (int dy = -1; (dy <= 1) && !active; dy++) {
+					const uint8_t* row = this->tiles_changed.data() + t + dy * (this->tiles_width + 2);
+					active = (row[-1] | row[0] | row[1]) != 0;
+				}
+				this->next_tiles_changed[t] = active ? this->turn_tile(ty, tx) : 0;
+				active_num += active ? 1 : 0;
+			}
+		}
+		this->last_active_tiles_num += active_num;
+	}
+
+	void turn_bands() {
+		int b;
+		while ((b = this->next_band.fetch_add(1)) < this->bands_num) {
+			this->turn_tile_rows(b * this->band_tile_rows, min(this->tiles_height, (b + 1) * this->band_tile_rows));
+		}
+	}
+
+	void mark_changed(const int y, const int x) {
+		this->tiles_changed[this->tile_index(y / LIFE_TILE_ROWS, (x >> 6) / LIFE_TILE_WORDS)] = 1;
+	}
+
+	void work() {
+		uint64_t turns_num = 0;
+		while (true) {
+			{
+				unique_lock<mutex> pool_lock(this->pool_mutex);
+				this->pool_cv.wait(pool_lock, [&] { return this->pool_quit || (this->pool_turn != turns_num); });
+				if (this->pool_quit) {
+					return;
+				}
+				turns_num = this->pool_turn;
+			}
+			this->turn_bands();
+			{
+				lock_guard<mutex> pool_lock(this->pool_mutex);
+				if (--(this->pool_busy) == 0) {
+					this->pool_done_cv.notify_one();
+				}
+			}
+		}
+	}
+
+	uint64_t& word(const int y, const int x) {
+		return this->words[(y + 1) * this->stride + 1 + (x >> 6)];
+	}
+
+	uint64_t word(const int y, const int x) const {
+		return this->words[(y + 1) * this->stride + 1 + (x >> 6)];
+	}
+
+public:
+	LifeGrid(const int height, const int width, const set<int>& birth, const set<int>& survival)
+	: height {height}, width {width}, tiles_skipping {true}, last_active_tiles_num {0}, next_band {0}, pool_turn {0}, pool_busy {0}, pool_quit {false} {
+		this->words_num = (width + 63) >> 6;
+		this->stride = this->words_num + 2;
+		this->tail_mask = ((width & 63) == 0) ? ~uint64_t(0) : ((uint64_t(1) << (width & 63)) - 1);
+		this->words.assign((height + 2) * this->stride, 0);
+		this->next_words.assign(this->words.size(), 0);
+		for (int n = 0; n <= 8; n++) {
+			this->rule[n] = (birth.count(n) ? 1 : 0) | (survival.count(n) ? 2 : 0);
+		}
+		this->tiles_height = (height + LIFE_TILE_ROWS - 1) / LIFE_TILE_ROWS;
+		this->tiles_width = (this->words_num + LIFE_TILE_WORDS - 1) / LIFE_TILE_WORDS;
+		this->tiles_changed.assign((this->tiles_height + 2) * (this->tiles_width + 2), 0);
+		this->next_tiles_changed.assign(this->tiles_changed.size(), 0);
+		this->mark_all_changed();
+		this->band_tile_rows = max(1, LIFE_BAND_WORDS / (this->stride * LIFE_TILE_ROWS));
+		this->bands_num = (this->tiles_height + this->band_tile_rows - 1) / this->band_tile_rows;
+	}
+
+	LifeGrid(const LifeGrid&) = delete;
+	LifeGrid& operator=(const LifeGrid&) = delete;
+
+	~LifeGrid() {
+		this->set_threads_num(1);
+	}
+
+	// Including caller of turn(), but no more than bands of rows; small grid is turned by caller alone
+	void set_threads_num(const int threads_num) {
+		int workers_num = max(0, min(threads_num, this->bands_num) - 1);
+		if (workers_num == int(this->workers.size())) {
+			return;
+		}
+		{
+			lock_guard<mutex> pool_lock(this->pool_mutex);
+			this->pool_quit = true;
+		}
+		this->pool_cv.notify_all();
+		for (auto& worker : this->workers) {
+			worker.join();
+		}
+		this->workers.clear();
+		this->pool_quit = false;
+		for (int i = 0; i < workers_num; i++) {
+			this->workers.emplace_back(&LifeGrid::work, this);
+		}
+	}
+
+	int threads_num() const {
+		return 1 + this->workers.size();
+	}
+
+	uint8_t get_cell(const int y, const int x) const {
+		return (this->word(y, x) >> (x & 63)) & 1;
+	}
+
+	// Setting cells, incl. to the same state, marks their tiles as changed, so that next turn does not skip them
+
+	void set_cell(const int y, const int x, const uint8_t c) {
+		uint64_t bit = uint64_t(1) << (x & 63);
+		this->word(y, x) = (c & 1) ? (this->word(y, x) | bit) : (this->word(y, x) & ~bit);
+		this->mark_changed(y, x);
+	}
+
+	void flip_cell(const int y, const int x) {
+		this->word(y, x) ^= uint64_t(1) << (x & 63);
+		this->mark_changed(y, x);
+	}
+
+	// Up to 64 cells from (y, x) on, within row, as bits from 0
+	uint64_t get_cells(const int y, const int x, const int n) const {
+		const uint64_t* p = &this->words[(y + 1) * this->stride + 1 + (x >> 6)];
+		int shift = x & 63;
+		uint64_t bits = (shift > 0) ? ((p[0] >> shift) | (p[1] << (64 - shift))) : p[0]; // p[1] is at most padding word
+		return (n < 64) ? (bits & ((uint64_t(1) << n) - 1)) : bits;
+	}
+
+	void set_cells(const int y, const int x, const int n, const uint64_t bits) {
+		uint64_t* p = &this->words[(y + 1) * this->stride + 1 + (x >> 6)];
+		int shift = x & 63;
+		uint64_t mask = (n < 64) ? ((uint64_t(1) << n) - 1) : ~uint64_t(0);
+		uint64_t b = bits & mask;
+		p[0] = (p[0] & ~(mask << shift)) | (b << shift);
+		if ((shift > 0) && (shift + n > 64)) {
+			p[1] = (p[1] & ~(mask >> (64 - shift))) | (b >> (64 - shift));
+		}
+		this->mark_changed(y, x);
+		this->mark_changed(y, x + n - 1);
+	}
+
+	void clear() {
+		fill(this->words.begin(), this->words.end(), 0);
+		this->mark_all_changed();
+	}
+
+	void mark_all_changed() {
+		for (int ty = 0; ty < this->tiles_height; ty++) {
+			fill_n(this->tiles_changed.begin() + this->tile_index(ty, 0), this->tiles_width, 1);
+		}
+	}
+
+	// On by default; off, all tiles are turned each time, e.g. to measure what skipping saves
+	void set_tiles_skipping(const bool skipping) {
+		this->tiles_skipping = skipping;
+	}
+
+	int tiles_num() const {
+		return this->tiles_height * this->tiles_width;
+	}
+
+	// Of tiles_num(), not skipped by last turn
+	int active_tiles_num() const {
+		return this->last_active_tiles_num;
+	}
+
+	void turn() {
+		this->last_active_tiles_num = 0;
+		if (this->workers.empty()) {
+			this->turn_tile_rows(0, this->tiles_height);
+		} else {
+			this->next_band = 0;
+			{
+				lock_guard<mutex> pool_lock(this->pool_mutex);
+				this->pool_turn++;
+				this->pool_busy = this->workers.size();
+			}
+			this->pool_cv.notify_all();
+			this->turn_bands();
+			unique_lock<mutex> pool_lock(this->pool_mutex);
+			this->pool_done_cv.wait(pool_lock, [&] { return this->pool_busy == 0; });
+		}
+		swap(this->words, this->next_words);
+		swap(this->tiles_changed, this->next_tiles_changed);
+	}
+
+	static const char* kernel_name() {
+#if defined(__AVX2__)
+		return "AVX2";
+#elif defined(__SSE2__)
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+};
+
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Emyzelium (C++)
+ *
+ * is another wrapper around ZeroMQ's Publish-Subscribe messaging pattern
+ * with mandatory Curve security and optional ZAP authentication filter,
+ * over Tor, through Tor SOCKS proxy,
+ * for distributed artificial elife, decision making etc. systems where
+ * each peer, identified by its public key, onion address, and port,
+ * publishes and updates vectors of vectors of bytes of data
+ * under unique topics that other peers subscribe to
+ * and receive the respective data.
+ * 
+ * https://github.com/emyzelium/emyzelium-cpp
+ * 
+ * emyzelium@protonmail.com
+ * 
+ * Copyright (c) 2022-2024 Emyzelium caretakers
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * Zone etales of demo: right third of realm, sent to others, which may put it into their left third.
+ * "zone" has byte per cell, as understood by all versions; "zone2" has bit per cell, and is advertised in "" etale
+ * of publisher, so that subscriber switches to it only if publisher sends it (see Realm_CA::negotiate_zones() of demo)
+ */
+
+#ifndef EMYZELIUM_DEMO_ZONE_HPP
+#define EMYZELIUM_DEMO_ZONE_HPP
+
+
+#include "life.hpp"
+
+#include <cstring>
+#include <string>
+
+
+const string ZONE_TITLE = "zone";
+const string ZONE_DESCRIPTION = "2B height (h), 2B width (w), h×wB zone by rows";
+const string ZONE2_TITLE = "zone2";
+const string ZONE2_DESCRIPTION = "2B height (h), 2B width (w), h×ceil(w/8)B zone by rows, bit k of byte i being cell 8i+k";
+
+
+// Cells of rectangle of grid at (0, x0)
+inline vector<vector<uint8_t>> zone_to_etale(const LifeGrid& grid, const int x0, const int zh, const int zw, const bool bits) {
+	vector<vector<uint8_t>> parts;
+
+	parts.emplace_back(2);
+	memcpy(parts[0].data(), &zh, 2);
+
+	parts.emplace_back(2);
+	memcpy(parts[1].data(), &zw, 2);
+
+	if (bits) {
+		int row_len = (zw + 7) >> 3;
+		parts.emplace_back(zh * row_len);
+		for (int y = 0; y < zh; y++) {
+			uint8_t* row = parts[2].data() + y * row_len;
+			for (int x = 0; x < zw; x += 64) {
+				int n = min(64, zw - x);
+				uint64_t cells = grid.get_cells(y, x0 + x, n);
+				memcpy(row + (x >> 3), &cells, (n + 7) >> 3);
+			}
+		}
+	} else {
+		parts.emplace_back(zh * zw);
+		for (int y = 0; y < zh; y++) {
+			for (int x = 0; x < zw; x++) {
+				parts[2][y * zw + x] = grid.get_cell(y, x0 + x);
+			}
+		}
+	}
+
+	return parts;
+}
+
+
+// Into rectangle of grid at (0, 0), cropped to max_zh x max_zw; whether etale was well-formed
+inline bool etale_to_zone(const vector<vector<uint8_t>>& parts, const bool bits, LifeGrid& grid, const int max_zh, const int max_zw) {
+	if ((parts.size() != 3) || (parts[0].size() != 2) || (parts[1].size() != 2)) {
+		return false;
+	}
+	uint16_t szh;
+	uint16_t szw;
+	memcpy(&szh, parts[0].data(), 2);
+	memcpy(&szw, parts[1].data(), 2);
+	size_t row_len = bits ? ((size_t(szw) + 7) >> 3) : size_t(szw);
+	if (parts[2].size() != szh * row_len) {
+		return false;
+	}
+	int dzh = min(int(szh), max_zh);
+	int dzw = min(int(szw), max_zw);
+	for (int y = 0; y < dzh; y++) {
+		const uint8_t* row = parts[2].data() + y * row_len;
+		if (bits) {
+			for (int x = 0; x < dzw; x += 64) {
+				int n = min(64, dzw - x);
+				uint64_t cells = 0;
+				memcpy(&cells, row + (x >> 3), (n + 7) >> 3);
+				grid.set_cells(y, x, n, cells);
+			}
+		} else {
+			for (int x = 0; x < dzw; x++) {
+				grid.set_cell(y, x, row[x]);
+			}
+		}
+	}
+	return true;
+}
+
+
+#endif
@@ -36,11 +36,25 @@
 
 #include "emyzelium.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <list>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
 #include <random>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 
 using namespace std;
@@ -61,6 +75,47 @@ const int DEF_IPV6_STATUS = 1;
 
 const size_t MAX_PUBLICKEYS_FILE_LINE_LEN = 96;
 
+const int MAX_EPOLL_EVENTS = 256;
+
+const uint32_t EMPTY_SLOT = 0;
+const uint32_t DELETED_SLOT = 1;
+const uint32_t SLOT_INDEX_BASE = 2;
+const size_t MIN_SLOTS_NUM = 8;
+
+const size_t MAX_ZAP_VERDICTS_NUM = 1024; // unclaimed by handshake events, e.g. when peer disconnects in between
+
+const size_t MIN_ZEROCOPY_PART_LEN = 1024; // shorter parts are cheaper to copy than to hand over with zmq_msg_init_data()
+
+// Rle part is 4-byte length of unpacked part, then runs, each starting with control byte c:
+// c < RLE_REPEAT_BASE is followed by c + 1 literal bytes, otherwise by 1 byte repeated c - RLE_REPEAT_OFFSET times
+const size_t RLE_HEADER_LEN = 4;
+const uint8_t RLE_REPEAT_BASE = 128;
+const size_t RLE_REPEAT_OFFSET = 125;
+const size_t RLE_MAX_LITERAL_LEN = RLE_REPEAT_BASE;
+const size_t RLE_MIN_REPEAT_LEN = RLE_REPEAT_BASE - RLE_REPEAT_OFFSET;
+const size_t RLE_MAX_REPEAT_LEN = 255 - RLE_REPEAT_OFFSET;
+
+// Delta-encoded etale has, after codecs in time frame, 4-byte number of its keyframe, with this bit set if it is keyframe itself
+const size_t KEYFRAME_REF_LEN = 4;
+const uint32_t KEYFRAME_BIT = uint32_t(1) << 31;
+
+// Chunk of large etale has, after t_out in time frame, 4-byte index of chunk and 4-byte number of chunks, and then single frame of data
+const size_t CHUNK_HEADER_LEN = 8;
+const int64_t CHUNKS_BURST_MUSEC = 10000; // of rate limit
+
+// Topic frame of etale replayed by last-value cache is title, zero byte, this byte, zero byte, so that it still matches subscriptions to title
+const uint8_t REPLAY_MARK = 1;
+
+// Snapshot file of Efunguz::save_snapshot() is magic, 4-byte version, 4-byte number of records, and their 8-byte offsets, sorted by key of record;
+// record is 8-byte t_out and t_in, 4-byte lengths of key and of title of latest message, 4-byte number of parts, then key (serverkey of ehypha,
+// byte of kind, title or prefix) and title, then 8-byte lengths of parts, then parts. Record and each part start at multiple of 8
+const char SNAPSHOT_MAGIC[8] = {'E', 'M', 'Y', 'Z', 'S', 'N', 'A', 'P'};
+const uint32_t SNAPSHOT_VERSION = 1;
+const size_t SNAPSHOT_HEADER_LEN = 16;
+const size_t SNAPSHOT_RECORD_HEADER_LEN = 32;
+const char SNAPSHOT_KIND_TITLE = 0;
+const char SNAPSHOT_KIND_PREFIX = 1;
+
 
 int64_t time_musec() {
 	return chrono::duration_cast<chrono::microseconds>(chrono::high_resolution_clock::now().time_since_epoch()).count();
@@ -72,6 +127,12 @@ string cut_pad_key_str(const string& s) {
 }
 
 
+// Only these transports go through ZMTP handshake, where Curve and ZAP apply
+bool is_curve_endpoint(const string& endpoint) {
+	return (endpoint.compare(0, 6, "tcp://") == 0) || (endpoint.compare(0, 6, "ipc://") == 0);
+}
+
+
 vector<uint8_t> cstr_to_vec_u8(const char *s) {
 	size_t l = strlen(s);
 	vector<uint8_t> bs(l);
@@ -97,15 +158,135 @@ int zmqe_getsockopt_events(zsocket* socket) {
 }
 
 
-void zmqe_send(zsocket* socket, const vector<vector<uint8_t>>& parts) {
+int zmqe_getsockopt_fd(zsocket* socket) {
+	int option_value = -1;
+	size_t option_len = sizeof(int);
+	zmq_getsockopt(socket, ZMQ_FD, &option_value, &option_len);
+	return option_value;
+}
+
+
+#ifdef __linux__
+// ZMQ_FD of socket is readable when socket has unprocessed commands, including "new messages"; ZMQ_EVENTS processes them and clears it.
+// As long as each socket is drained until ZMQ_EVENTS lacks ZMQ_POLLIN, epoll reports exactly those sockets that need attention.
+// Pipes attached without command (e.g. by inproc connect) stay silent until the first check, so drain each socket once after adding it
+void zmqe_epoll_add(int epoll_fd, zsocket* socket, void* tag) {
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.ptr = tag;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, zmqe_getsockopt_fd(socket), &event);
+}
+
+
+void zmqe_epoll_del(int epoll_fd, zsocket* socket) {
+	epoll_event event{}; // ignored, but must be non-null before Linux 2.6.9
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, zmqe_getsockopt_fd(socket), &event);
+}
+
+
+// Ehypha is tagged by its address, and its monitor, by the same address with lowest bit set, which is otherwise 0 due to alignment
+void* ehypha_mon_tag(Ehypha* ehypha) {
+	return (void*)(uintptr_t(ehypha) | 1);
+}
+#endif
+
+
+string fd_peer_address(const int fd) {
+	sockaddr_storage addr{};
+	socklen_t addr_len = sizeof(addr);
+	if (getpeername(fd, (sockaddr*)&addr, &addr_len) != 0) {
+		return "";
+	}
+	char ip_cstr[INET6_ADDRSTRLEN]{0};
+	if (addr.ss_family == AF_INET) {
+		const sockaddr_in* addr4 = (const sockaddr_in*)&addr;
+		inet_ntop(AF_INET, &(addr4->sin_addr), ip_cstr, sizeof(ip_cstr));
+		return string(ip_cstr) + ":" + to_string(ntohs(addr4->sin_port));
+	} else if (addr.ss_family == AF_INET6) {
+		const sockaddr_in6* addr6 = (const sockaddr_in6*)&addr;
+		if (IN6_IS_ADDR_V4MAPPED(&(addr6->sin6_addr))) { // since PUB socket listens with ZMQ_IPV6
+			inet_ntop(AF_INET, &(addr6->sin6_addr.s6_addr[12]), ip_cstr, sizeof(ip_cstr));
+			return string(ip_cstr) + ":" + to_string(ntohs(addr6->sin6_port));
+		}
+		inet_ntop(AF_INET6, &(addr6->sin6_addr), ip_cstr, sizeof(ip_cstr));
+		return "[" + string(ip_cstr) + "]:" + to_string(ntohs(addr6->sin6_port));
+	} else {
+		return ""; // ipc
+	}
+}
+
+
+bool zmqe_send_msg(zsocket* socket, zmq_msg_t* msg, const bool more) {
+	if (zmq_msg_send(msg, socket, ZMQ_DONTWAIT | (more ? ZMQ_SNDMORE : 0)) < 0) {
+		zmq_msg_close(msg); // calls free function of zero-copy message, if any
+		return false;
+	}
+	return true;
+}
+
+
+// Whether topic frame of title, i.e. title and zero byte, starts with prefix
+bool topic_matches(const string& title, const char* prefix, const size_t prefix_len) {
+	if (prefix_len <= title.size()) {
+		return title.compare(0, prefix_len, prefix, prefix_len) == 0;
+	} else {
+		return (prefix_len == title.size() + 1) && (title.compare(0, title.size(), prefix, title.size()) == 0) && (prefix[title.size()] == 0);
+	}
+}
+
+
+// Title and zero byte, see REPLAY_MARK for replayed etale
+void zmqe_msg_init_topic(zmq_msg_t* msg, const string& title, const bool replayed) {
+	zmq_msg_init_size(msg, title.size() + (replayed ? 3 : 1));
+	uint8_t* topic = (uint8_t*)zmq_msg_data(msg);
+	title.copy((char *)topic, title.size());
+	topic[title.size()] = 0;
+	if (replayed) {
+		topic[title.size() + 1] = REPLAY_MARK;
+		topic[title.size() + 2] = 0;
+	}
+}
+
+
+bool zmqe_send_copy(zsocket* socket, const void* data, const size_t size, const bool more) {
 	zmq_msg_t msg;
+	zmq_msg_init_size(&msg, size);
+	if (size > 0) {
+		memcpy(zmq_msg_data(&msg), data, size);
+	}
+	return zmqe_send_msg(socket, &msg, more);
+}
+
+
+// Items are caller's, so that their capacity is reused
+void wait_fds_readable(const vector<int>& fds, const long timeout_ms, vector<pollfd>& items) {
+	items.resize(fds.size());
+	for (size_t i = 0; i < fds.size(); i++) {
+		items[i].fd = fds[i];
+		items[i].events = POLLIN;
+	}
+	poll(items.data(), items.size(), (int)timeout_ms);
+}
+
+
+void zmqe_free_vec_u8(void*, void* hint) {
+	delete (vector<uint8_t>*)hint;
+}
+
+
+void zmqe_free_shared_part(void*, void* hint) {
+	delete (shared_part*)hint; // only decrements refcount, unless the caller has already dropped the part
+}
+
+
+void zmqe_free_warm_snapshot(void*, void* hint) {
+	delete (shared_ptr<WarmSnapshot>*)hint; // file is unmapped when no part refers to it anymore
+}
+
+
+void zmqe_send(zsocket* socket, const vector<vector<uint8_t>>& parts) {
 	for (size_t i = 0; i < parts.size(); i++) {
-		size_t size = parts[i].size();
-		zmq_msg_init_size(&msg, size);
-		memcpy(zmq_msg_data(&msg), parts[i].data(), size);
-		if (zmq_msg_send(&msg, socket, (i + 1) < parts.size() ? ZMQ_SNDMORE : 0) < 0) {
-			zmq_msg_close(&msg);
-		}
+		zmqe_send_copy(socket, parts[i].data(), parts[i].size(), (i + 1) < parts.size());
 	}
 }
 
@@ -129,290 +310,2234 @@ vector<vector<uint8_t>> zmqe_recv(zsocket* socket) {
 }
 
 
-Etale::Etale(const vector<vector<uint8_t>>& parts, const int64_t t_out, const int64_t t_in, const bool paused)
-: parts {parts}, t_out {t_out}, t_in {t_in}, paused {paused} {
-}
-
-
-Ehypha::Ehypha(zcontext* context, const string& secretkey, const string& publickey, const string& serverkey, const string& onion, const uint16_t pubsub_port, const uint16_t torproxy_port, const string& torproxy_host) {
-	this->subsock = zmq_socket(context, ZMQ_SUB);
-	zmqe_setsockopt(this->subsock, ZMQ_CURVE_SECRETKEY, secretkey.c_str());
-	zmqe_setsockopt(this->subsock, ZMQ_CURVE_PUBLICKEY, publickey.c_str());
-	zmqe_setsockopt(this->subsock, ZMQ_CURVE_SERVERKEY, serverkey.c_str());
-	zmqe_setsockopt(this->subsock, ZMQ_SOCKS_PROXY, (torproxy_host + ":" + to_string(torproxy_port)).c_str());
-	zmq_connect(this->subsock, ("tcp://" + onion + ".onion:" + to_string(pubsub_port)).c_str());
+// Buffer of len bytes: spare itself, with its capacity, if nothing else refers to it anymore (e.g. ZeroMQ has released message
+// made of it), else new one, which becomes spare
+shared_ptr<vector<uint8_t>> reuse_spare(shared_ptr<vector<uint8_t>>& spare, const size_t len) {
+	if (spare && (spare.use_count() == 1)) {
+		atomic_thread_fence(memory_order_acquire); // pairs with release of last other owner, e.g. in I/O thread of ZeroMQ
+		spare->resize(len);
+	} else {
+		spare = make_shared<vector<uint8_t>>(len);
+	}
+	return spare;
 }
 
 
-tuple<const Etale&, EW> Ehypha::add_etale(const string& title) {
-	if (this->etales.count(title) == 0) {
-		zmqe_setsockopt(this->subsock, ZMQ_SUBSCRIBE, title.c_str());
-		// emplace() instead of insert() to avoid redundant destruction and copying of Etale (see also Efunguz::add_ehypha())
-		this->etales.emplace(piecewise_construct,
-			tuple<string>{title},
-			tuple<>{}
-		);
-		return tuple<const Etale&, EW>{this->etales.at(title), EW::Ok};
-	} else {
-		return tuple<const Etale&, EW>{this->etales.at(title), EW::AlreadyPresent};
+// As in Ehypha::reassemble(): length of time tail, time tail (codecs etc.), number of parts, their lengths, their data
+shared_part serialize_etale(const uint8_t* time_tail, const size_t time_tail_len, const vector<pair<const uint8_t*, size_t>>& parts, shared_ptr<vector<uint8_t>>& spare) {
+	size_t len = 4 + time_tail_len + 4 + 8 * parts.size();
+	for (const auto& part : parts) {
+		len += part.second;
+	}
+	shared_ptr<vector<uint8_t>> etale = reuse_spare(spare, len);
+	uint8_t* data = etale->data();
+	uint32_t time_tail_len32 = uint32_t(time_tail_len);
+	uint32_t parts_num = uint32_t(parts.size());
+	memcpy(data, &time_tail_len32, 4);
+	data += 4;
+	if (time_tail_len > 0) {
+		memcpy(data, time_tail, time_tail_len);
+		data += time_tail_len;
+	}
+	memcpy(data, &parts_num, 4);
+	data += 4;
+	for (const auto& part : parts) {
+		uint64_t part_len = part.second;
+		memcpy(data, &part_len, 8);
+		data += 8;
+	}
+	for (const auto& part : parts) {
+		if (part.second > 0) {
+			memcpy(data, part.first, part.second);
+			data += part.second;
+		}
 	}
+	return etale;
 }
 
 
-tuple<const Etale*, EW> Ehypha::get_etale_ptr(const string& title) {
-	if (this->etales.count(title) == 1) {
-		return tuple<const Etale*, EW>{&(this->etales.at(title)), EW::Ok};
-	} else {
-		return tuple<const Etale*, EW>{nullptr, EW::Absent};
+// Returns length of packed part, or 0 if it would be at least as long as unpacked one; dst must hold len bytes
+size_t rle_pack(const uint8_t* src, const size_t len, uint8_t* dst) {
+	if ((len <= RLE_HEADER_LEN) || (len > UINT32_MAX)) {
+		return 0;
+	}
+	uint32_t len32 = uint32_t(len);
+	memcpy(dst, &len32, RLE_HEADER_LEN);
+	size_t o = RLE_HEADER_LEN;
+	size_t i = 0;
+	while (i < len) {
+		size_t repeat_len = 1;
+		while ((i + repeat_len < len) && (repeat_len < RLE_MAX_REPEAT_LEN) && (src[i + repeat_len] == src[i])) {
+			repeat_len++;
+		}
+		if (repeat_len >= RLE_MIN_REPEAT_LEN) {
+			if (o + 2 > len) {
+				return 0;
+			}
+			dst[o++] = uint8_t(RLE_REPEAT_OFFSET + repeat_len);
+			dst[o++] = src[i];
+			i += repeat_len;
+		} else {
+			// Literal run lasts until next repeat worth encoding
+			size_t j = i + 1;
+			while ((j < len) && (j - i < RLE_MAX_LITERAL_LEN) && !((j + 2 < len) && (src[j] == src[j + 1]) && (src[j] == src[j + 2]))) {
+				j++;
+			}
+			if (o + 1 + (j - i) > len) {
+				return 0;
+			}
+			dst[o++] = uint8_t(j - i - 1);
+			memcpy(dst + o, src + i, j - i);
+			o += j - i;
+			i = j;
+		}
 	}
+	return (o < len) ? o : 0;
 }
 
 
-EW Ehypha::del_etale(const string& title) {
-	if (this->etales.count(title) == 1) {
-		this->etales.erase(title);
-		zmqe_setsockopt(this->subsock, ZMQ_UNSUBSCRIBE, title.c_str());
-		return EW::Ok;
-	} else {
-		return EW::AlreadyAbsent;
+// Unpacked length, or SIZE_MAX if it is implausible for packed length
+size_t rle_unpacked_len(const uint8_t* src, const size_t len) {
+	if (len < RLE_HEADER_LEN) {
+		return SIZE_MAX;
 	}
+	uint32_t len32 = 0;
+	memcpy(&len32, src, RLE_HEADER_LEN);
+	// Each 2 bytes of runs unpack to at most RLE_MAX_REPEAT_LEN, so that peer cannot make us allocate much more than it sends
+	return (len32 <= (len - RLE_HEADER_LEN) / 2 * RLE_MAX_REPEAT_LEN) ? size_t(len32) : SIZE_MAX;
 }
 
 
-EW Ehypha::pause_etale(const string& title) {
-	if (this->etales.count(title) == 1) {
-		Etale& etale = this->etales.at(title);
-		if (!etale.paused) {
-			zmqe_setsockopt(this->subsock, ZMQ_UNSUBSCRIBE, title.c_str());
-			etale.paused = true;
-			return EW::Ok;
+// Whether runs fill dst exactly
+bool rle_unpack(const uint8_t* src, const size_t len, uint8_t* dst, const size_t dst_len) {
+	size_t i = RLE_HEADER_LEN;
+	size_t o = 0;
+	while (i < len) {
+		uint8_t c = src[i++];
+		if (c < RLE_REPEAT_BASE) {
+			size_t literal_len = size_t(c) + 1;
+			if ((i + literal_len > len) || (o + literal_len > dst_len)) {
+				return false;
+			}
+			memcpy(dst + o, src + i, literal_len);
+			i += literal_len;
+			o += literal_len;
 		} else {
-			return EW::AlreadyPaused;
+			size_t repeat_len = size_t(c) - RLE_REPEAT_OFFSET;
+			if ((i + 1 > len) || (o + repeat_len > dst_len)) {
+				return false;
+			}
+			memset(dst + o, src[i++], repeat_len);
+			o += repeat_len;
 		}
-	} else {
-		return EW::Absent;
 	}
+	return o == dst_len;
 }
 
 
-EW Ehypha::resume_etale(const string& title) {
-	if (this->etales.count(title) == 1) {
-		Etale& etale = this->etales.at(title);
-		if (etale.paused) {
-			zmqe_setsockopt(this->subsock, ZMQ_SUBSCRIBE, title.c_str());
-			etale.paused = false;
-			return EW::Ok;
-		} else {
-			return EW::AlreadyResumed;
-		}
-	} else {
-		return EW::Absent;
+vector<const vector<uint8_t>*> part_ptrs(const vector<vector<uint8_t>>& parts) {
+	vector<const vector<uint8_t>*> ptrs;
+	for (const auto& part : parts) {
+		ptrs.push_back(&part);
 	}
+	return ptrs;
 }
 
 
-void Ehypha::pause_etales() {
-	for (const auto& keyval : this->etales) {
-		this->pause_etale(keyval.first);
+vector<const vector<uint8_t>*> part_ptrs(const vector<shared_part>& parts) {
+	vector<const vector<uint8_t>*> ptrs;
+	for (const auto& part : parts) {
+		ptrs.push_back(part.get());
 	}
+	return ptrs;
 }
 
-void Ehypha::resume_etales() {
-	for (const auto& keyval : this->etales) {
-		this->resume_etale(keyval.first);
-	}
+
+// Each counter has single writer, so plain store is enough, without (locked) read-modify-write
+void add_relaxed(atomic<uint64_t>& counter, const uint64_t delta) {
+	counter.store(counter.load(memory_order_relaxed) + delta, memory_order_relaxed);
 }
 
 
-void Ehypha::update() {
-	int64_t t = time_musec();
+struct RecvCounters {
+	atomic<uint64_t> msgs_num;
+	atomic<uint64_t> bytes_num;
+	atomic<uint64_t> malformed_num;
+	atomic<uint64_t> paused_num;
+	atomic<uint64_t> unbased_num;
+	atomic<uint64_t> replayed_num;
+	atomic<uint64_t> dropped_chunks_num;
+	atomic<int64_t> last_gap;
+	atomic<uint64_t> latency_hist[LATENCY_BINS_NUM];
+	int64_t t_last_in; // of writer only
+
+	RecvCounters();
+	void count(const int64_t t_in, const size_t bytes_num, const bool wellformed, const int64_t t_out, const bool paused, const bool unbased, const bool replayed);
+	void drop_chunks(const uint64_t chunks_num, const size_t bytes_num);
+	RecvStats load() const;
+};
+
+
+struct EmitCounters {
+	atomic<uint64_t> msgs_num;
+	atomic<uint64_t> bytes_num;
+	atomic<uint64_t> packed_bytes_num;
+	atomic<uint64_t> failed_num;
+
+	EmitCounters();
+	EmitStats load() const;
+};
+
+
+RecvCounters::RecvCounters()
+: msgs_num {0}, bytes_num {0}, malformed_num {0}, paused_num {0}, unbased_num {0}, replayed_num {0}, dropped_chunks_num {0}, last_gap {-1}, t_last_in {-1} {
+	for (auto& num : this->latency_hist) {
+		num.store(0, memory_order_relaxed);
+	}
+}
 
-	while (zmqe_getsockopt_events(this->subsock) & ZMQ_POLLIN != 0) {
-		auto msg_parts = zmqe_recv(this->subsock);
-		if (msg_parts.size() >= 2) {
-			// 0th is topic, 1st is remote time, rest (optional) is data
-			const vector<uint8_t>& topic = msg_parts[0];
-			if ((topic.size() >= 1) && (topic[topic.size() - 1] == 0)) {
-				string title((char *)topic.data());
-				if (this->etales.count(title) == 1) {
-					Etale& etale = this->etales.at(title);
-					if (!etale.paused) {
-						if (msg_parts[1].size() == 8) {
-							etale.parts.clear();
-							// etale.parts.shrink_to_fit();
-							for (size_t i = 2; i < msg_parts.size(); i++) {
-								etale.parts.emplace_back(move(msg_parts[i]));
-							}
-							etale.t_out = *((int64_t*)msg_parts[1].data());
-							etale.t_in = t;
-						}
-					}
-				}
+
+void RecvCounters::count(const int64_t t_in, const size_t bytes_num, const bool wellformed, const int64_t t_out, const bool paused, const bool unbased, const bool replayed) {
+	add_relaxed(this->msgs_num, 1);
+	add_relaxed(this->bytes_num, bytes_num);
+	if (this->t_last_in >= 0) {
+		this->last_gap.store(t_in - this->t_last_in, memory_order_relaxed);
+	}
+	this->t_last_in = t_in;
+	if (!wellformed) {
+		add_relaxed(this->malformed_num, 1);
+	} else if (paused) {
+		add_relaxed(this->paused_num, 1);
+	} else {
+		if (unbased) {
+			add_relaxed(this->unbased_num, 1);
+		}
+		if (replayed) {
+			add_relaxed(this->replayed_num, 1); // its latency is age of cached etale
+		} else {
+			int64_t latency = t_in - t_out;
+			size_t bin = 0;
+			while ((bin + 1 < LATENCY_BINS_NUM) && ((latency >> bin) > 0)) {
+				bin++;
 			}
+			add_relaxed(this->latency_hist[bin], 1);
 		}
 	}
 }
 
 
-Ehypha::~Ehypha() {
-	zmq_close(this->subsock);
+void RecvCounters::drop_chunks(const uint64_t chunks_num, const size_t bytes_num) {
+	add_relaxed(this->dropped_chunks_num, chunks_num);
+	add_relaxed(this->bytes_num, bytes_num);
 }
 
 
-Efunguz::Efunguz(const string& secretkey, const unordered_set<string>& whitelist_publickeys, const uint16_t pubsub_port, const uint16_t torproxy_port, const string& torproxy_host)
-: pubsub_port {pubsub_port}, torproxy_port {torproxy_port}, torproxy_host {torproxy_host} {
-	this->secretkey = cut_pad_key_str(secretkey);
+RecvStats RecvCounters::load() const {
+	RecvStats stats;
+	stats.msgs_num = this->msgs_num.load(memory_order_relaxed);
+	stats.bytes_num = this->bytes_num.load(memory_order_relaxed);
+	stats.malformed_num = this->malformed_num.load(memory_order_relaxed);
+	stats.paused_num = this->paused_num.load(memory_order_relaxed);
+	stats.unbased_num = this->unbased_num.load(memory_order_relaxed);
+	stats.replayed_num = this->replayed_num.load(memory_order_relaxed);
+	stats.dropped_chunks_num = this->dropped_chunks_num.load(memory_order_relaxed);
+	stats.last_gap = this->last_gap.load(memory_order_relaxed);
+	for (size_t i = 0; i < LATENCY_BINS_NUM; i++) {
+		stats.latency_hist[i] = this->latency_hist[i].load(memory_order_relaxed);
+	}
+	return stats;
+}
 
-	char publickey_cstr[KEY_Z85_CSTR_LEN]{0};
-	zmq_curve_public(publickey_cstr, this->secretkey.c_str());
-	this->publickey = cut_pad_key_str(string(publickey_cstr));
 
-	for (const auto& key : whitelist_publickeys) {
-		this->whitelist_publickeys.insert(cut_pad_key_str(key));
-	}
+EmitCounters::EmitCounters()
+: msgs_num {0}, bytes_num {0}, packed_bytes_num {0}, failed_num {0} {
+}
 
-	this->context = zmq_ctx_new();
-	zmq_ctx_set(this->context, ZMQ_IPV6, DEF_IPV6_STATUS);
-	zmq_ctx_set(this->context, ZMQ_BLOCKY, 0);
 
-	// At first, REP socket for ZAP auth...
-	this->zapsock = zmq_socket(this->context, ZMQ_REP);
-	zmq_bind(this->zapsock, "inproc://zeromq.zap.01");
+struct EmitPacking {
+	Ecodec codec; // of keyframes (or of all etales, if not delta-encoded): Raw or Rle
+	size_t min_part_len;
+	size_t keyframe_interval; // 0 if not delta-encoded
+	uint32_t keyframe_num;
+	size_t deltas_num; // since last keyframe
+	vector<vector<uint8_t>> keyframe_parts; // as emitted, before compression
+	bool keyframe_emitted;
+	vector<shared_ptr<vector<uint8_t>>> spare_parts; // 2 per part, for delta and for compressed one, see reuse_spare()
+	shared_ptr<vector<uint8_t>> spare_serialized; // of chunked etale
+	vector<uint8_t> xored; // keeps capacity
 
-	random_device randev;
-	this->zap_session_id.assign(ZAP_SESSION_ID_LEN, 0);
-	for (size_t i = 0; i < ZAP_SESSION_ID_LEN; i++) {
-		this->zap_session_id[i] = randev() & 0xFF; // must be cryptographically random... is it?
-	}
+	EmitPacking();
+};
 
-	// ..and only then, PUB socket
-	this->pubsock = zmq_socket(this->context, ZMQ_PUB);
-	zmqe_setsockopt(this->pubsock, ZMQ_CURVE_SERVER, 1);
-	zmqe_setsockopt(this->pubsock, ZMQ_CURVE_SECRETKEY, this->secretkey.c_str());
-	zmq_setsockopt(this->pubsock, ZMQ_ZAP_DOMAIN, ZAP_DOMAIN, strlen(ZAP_DOMAIN)); // to enable auth, must be non-empty due to ZMQ RFC 27
-	zmq_setsockopt(this->pubsock, ZMQ_ROUTING_ID, this->zap_session_id.data(), ZAP_SESSION_ID_LEN); // to make sure only this pubsock can pass auth through zapsock; see update()
 
-	// Before binding, attach monitor
-	zmq_socket_monitor(this->pubsock, "inproc://monitor-pub", ZMQ_EVENT_ALL);
-	this->monsock = zmq_socket(this->context, ZMQ_PAIR);
-	zmq_connect(this->monsock, "inproc://monitor-pub");
+EmitPacking::EmitPacking()
+: codec {Ecodec::Raw}, min_part_len {DEF_MIN_COMPRESSED_PART_LEN}, keyframe_interval {0}, keyframe_num {0}, deltas_num {0}, keyframe_emitted {false} {
+}
 
-	zmq_bind(this->pubsock, (string("tcp://*:") + to_string(this->pubsub_port)).c_str());
 
-	this->in_accepted_num = 0;
-	this->in_handshake_succeeded_num = 0;
-	this->in_disconnected_num = 0;
+// Chunked etales of one title, sent one after another
+struct EmitChunks {
+	string title;
+	deque<tuple<int64_t, shared_part, size_t, bool>> etales; // t_out, serialized etale, length of its chunks, and whether it is replayed
+	uint32_t next_index; // of chunk of front etale
+};
+
+
+struct CachedEtale {
+	int64_t t_out; // -1 if none
+	vector<Epart> frames; // time and parts, as emitted...
+	shared_part serialized; // ...or, if chunked, etale serialized as in Ehypha::reassemble()
+	size_t chunk_len;
+
+	CachedEtale();
+};
+
+
+struct EmitCache {
+	CachedEtale keyframe; // of delta-encoded etales, base of latest one
+	CachedEtale latest;
+};
+
+
+struct OutCounters {
+	atomic<bool> connected;
+	atomic<uint64_t> connected_num;
+	atomic<uint64_t> retried_num;
+	atomic<uint64_t> handshake_failed_num;
+	atomic<uint64_t> disconnected_num;
+	atomic<int64_t> t_connected;
+	atomic<int64_t> t_disconnected;
+	atomic<int64_t> retry_ivl_ms;
+
+	OutCounters();
+	OutStats load() const;
+};
+
+
+struct WarmSnapshot {
+	const uint8_t* data; // mapped file
+	size_t len;
+	size_t records_num;
+
+	WarmSnapshot(const uint8_t* data, const size_t len);
+	size_t find(const string& key) const; // offset of record, SIZE_MAX if absent or malformed
+	~WarmSnapshot();
+};
+
+
+OutCounters::OutCounters()
+: connected {false}, connected_num {0}, retried_num {0}, handshake_failed_num {0}, disconnected_num {0}, t_connected {-1}, t_disconnected {-1}, retry_ivl_ms {-1} {
 }
 
 
-void Efunguz::add_whitelist_publickeys(const unordered_set<string>& publickeys) {
-	for (const auto& key : publickeys) {
-		this->whitelist_publickeys.insert(cut_pad_key_str(key));
-	}
+CachedEtale::CachedEtale()
+: t_out {-1}, chunk_len {0} {
 }
 
 
-void Efunguz::del_whitelist_publickeys(const unordered_set<string>& publickeys) {
-	for (const auto& key : publickeys) {
-		this->whitelist_publickeys.erase(cut_pad_key_str(key));
-	}
+OutStats OutCounters::load() const {
+	OutStats stats;
+	stats.connected = this->connected.load(memory_order_relaxed);
+	stats.connected_num = this->connected_num.load(memory_order_relaxed);
+	stats.retried_num = this->retried_num.load(memory_order_relaxed);
+	stats.handshake_failed_num = this->handshake_failed_num.load(memory_order_relaxed);
+	stats.disconnected_num = this->disconnected_num.load(memory_order_relaxed);
+	stats.t_connected = this->t_connected.load(memory_order_relaxed);
+	stats.t_disconnected = this->t_disconnected.load(memory_order_relaxed);
+	stats.retry_ivl_ms = this->retry_ivl_ms.load(memory_order_relaxed);
+	return stats;
 }
 
 
-void Efunguz::clear_whitelist_publickeys() {
-	this->whitelist_publickeys.clear();
+WarmSnapshot::WarmSnapshot(const uint8_t* data, const size_t len)
+: data {data}, len {len}, records_num {0} {
+	uint32_t records_num = 0;
+	memcpy(&records_num, data + 12, 4);
+	this->records_num = records_num;
 }
 
 
-void Efunguz::read_whitelist_publickeys(const string& filepath) {
-	ifstream ifs(filepath, ios_base::in);
-	char line_cstr_buf[MAX_PUBLICKEYS_FILE_LINE_LEN];
-	while (ifs.getline(line_cstr_buf, MAX_PUBLICKEYS_FILE_LINE_LEN)) {
-		string line(line_cstr_buf);
-		if (line.size() >= KEY_Z85_LEN) {
-			string key = line.substr(0, KEY_Z85_LEN);
-			this->whitelist_publickeys.insert(key);
+size_t WarmSnapshot::find(const string& key) const {
+	// Binary search, checking only records on the way
+	size_t lo = 0;
+	size_t hi = this->records_num;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		uint64_t offset = 0;
+		memcpy(&offset, this->data + SNAPSHOT_HEADER_LEN + 8 * mid, 8);
+		uint32_t key_len = 0;
+		if ((offset > this->len) || (this->len - offset < SNAPSHOT_RECORD_HEADER_LEN)) {
+			return SIZE_MAX;
+		}
+		memcpy(&key_len, this->data + offset + 16, 4);
+		if (this->len - offset - SNAPSHOT_RECORD_HEADER_LEN < key_len) {
+			return SIZE_MAX;
+		}
+		const uint8_t* that_key = this->data + offset + SNAPSHOT_RECORD_HEADER_LEN;
+		int cmp = memcmp(that_key, key.data(), min(size_t(key_len), key.size()));
+		if (cmp == 0) {
+			cmp = (key_len < key.size()) ? -1 : ((key_len > key.size()) ? 1 : 0);
+		}
+		if (cmp == 0) {
+			return offset;
+		} else if (cmp < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
 		}
 	}
+	return SIZE_MAX;
 }
 
 
-tuple<Ehypha&, EW> Efunguz::add_ehypha(const string& that_publickey, const string& onion, const uint16_t pubsub_port) {
-	string serverkey = cut_pad_key_str(that_publickey);
-	if (this->ehyphae.count(serverkey) == 0) {
-		// insert() would destroy temporary Ehypha, whose destructor would close its subsock, making copied subsock ptr useless
-		// (see the pair constructor in stl_pair.h that uses piecewise_construct_t)
-		this->ehyphae.emplace(piecewise_construct,
-			tuple<string>{serverkey},
-			tuple<zcontext*, string, string, string, string, uint16_t, uint16_t, string>{this->context, this->secretkey, this->publickey, serverkey, onion, pubsub_port, this->torproxy_port, this->torproxy_host}
-		);
-		return tuple<Ehypha&, EW>{this->ehyphae.at(serverkey), EW::Ok};
-	} else {
-		return tuple<Ehypha&, EW>{this->ehyphae.at(serverkey), EW::AlreadyPresent};
-	}
+WarmSnapshot::~WarmSnapshot() {
+	munmap((void*)this->data, this->len);
 }
 
 
-tuple<Ehypha*, EW> Efunguz::get_ehypha_ptr(const string& that_publickey) {
-	string serverkey = cut_pad_key_str(that_publickey);
-	if (this->ehyphae.count(serverkey) == 1) {
-		return tuple<Ehypha*, EW>{&(this->ehyphae.at(serverkey)), EW::Ok};
-	} else {
-		return tuple<Ehypha*, EW>{nullptr, EW::Absent};
-	}
+EmitStats EmitCounters::load() const {
+	EmitStats stats;
+	stats.msgs_num = this->msgs_num.load(memory_order_relaxed);
+	stats.bytes_num = this->bytes_num.load(memory_order_relaxed);
+	stats.packed_bytes_num = this->packed_bytes_num.load(memory_order_relaxed);
+	stats.failed_num = this->failed_num.load(memory_order_relaxed);
+	return stats;
 }
 
 
-EW Efunguz::del_ehypha(const string& that_publickey) {
-	string serverkey = cut_pad_key_str(that_publickey);
-	if (this->ehyphae.count(serverkey) == 1) {
-		this->ehyphae.erase(serverkey);
-		return EW::Ok;
-	} else {
-		return EW::AlreadyAbsent;
-	}
+Epart::Epart() {
+	zmq_msg_init(&this->msg);
 }
 
 
-void Efunguz::emit_etale(const string& title, const vector<vector<uint8_t>>& parts) {
-	vector<vector<uint8_t>> msg_parts{};
-
-	vector<uint8_t> topic(title.size() + 1);
-	title.copy((char *)topic.data(), title.size());
-	msg_parts.push_back(topic);
+Epart::Epart(const size_t size) {
+	zmq_msg_init_size(&this->msg, size);
+}
 
-	int64_t t_out = time_musec();
-	vector<uint8_t> t_out_bs(8);
-	memcpy(t_out_bs.data(), &t_out, 8);
-	msg_parts.push_back(t_out_bs);
 
-	for (const auto& part : parts) {
-		msg_parts.push_back(part);
+Epart::Epart(const uint8_t* data, const size_t size) {
+	zmq_msg_init_size(&this->msg, size);
+	if (size > 0) {
+		memcpy(zmq_msg_data(&this->msg), data, size);
 	}
-
-	zmqe_send(this->pubsock, msg_parts);
 }
 
 
-void Efunguz::update() {
-	while (zmqe_getsockopt_events(this->zapsock) & ZMQ_POLLIN != 0) {
-		vector<vector<uint8_t>> request = zmqe_recv(this->zapsock);
-		vector<vector<uint8_t>> reply;
+Epart::Epart(const Epart& other) {
+	zmq_msg_init(&this->msg);
+	zmq_msg_copy(&this->msg, const_cast<zmq_msg_t*>(&other.msg));
+}
 
-		auto& version = request[0];
-		auto& sequence = request[1];
-		// auto& domain = request[2];
-		// auto& address = request[3];
-		auto& identity = request[4];
-		auto& mechanism = request[5];
-		auto& key_u8 = request[6];
 
-		char key_cstr[KEY_Z85_CSTR_LEN]{0};
-		zmq_z85_encode(key_cstr, key_u8.data(), KEY_BIN_LEN);
-		string key(key_cstr);
+Epart::Epart(Epart&& other) {
+	zmq_msg_init(&this->msg);
+	zmq_msg_move(&this->msg, &other.msg);
+}
 
-		reply.push_back(version);
-		reply.push_back(sequence);
+
+Epart& Epart::operator=(const Epart& other) {
+	if (this != &other) {
+		zmq_msg_copy(&this->msg, const_cast<zmq_msg_t*>(&other.msg)); // releases previous content of this->msg
+	}
+	return *this;
+}
+
+
+Epart& Epart::operator=(Epart&& other) {
+	if (this != &other) {
+		zmq_msg_move(&this->msg, &other.msg); // same
+	}
+	return *this;
+}
+
+
+zmq_msg_t* Epart::zmsg() {
+	return &this->msg;
+}
+
+
+const uint8_t* Epart::data() const {
+	return (const uint8_t*)zmq_msg_data(const_cast<zmq_msg_t*>(&this->msg));
+}
+
+
+size_t Epart::size() const {
+	return zmq_msg_size(&this->msg);
+}
+
+
+Epart::~Epart() {
+	zmq_msg_close(&this->msg);
+}
+
+
+// Snapshots of etale, published by the thread that receives and acquired by readers without lock.
+// Nodes of list never move, and stay until etale is deleted, so reader may copy the latest one even if it is being superseded meanwhile;
+// list grows to the most snapshots held by readers at once, plus one
+struct SnapshotSlot {
+	atomic<const shared_ptr<Etale>*> latest; // nullptr until 1st publication
+	list<shared_ptr<Etale>> snapshots; // incl. latest, written by publisher only
+
+	SnapshotSlot();
+	shared_ptr<const Etale> acquire() const;
+};
+
+
+SnapshotSlot::SnapshotSlot()
+: latest {nullptr} {
+}
+
+
+shared_ptr<const Etale> SnapshotSlot::acquire() const {
+	const shared_ptr<Etale>* latest = this->latest.load(memory_order_acquire);
+	while (latest != nullptr) {
+		shared_ptr<const Etale> snapshot = *latest;
+		// Copy counts only if it is still the latest, otherwise publisher may have reused it before seeing this reader; pairs with fence in Ehypha::publish_snapshot()
+		atomic_thread_fence(memory_order_seq_cst);
+		const shared_ptr<Etale>* again = this->latest.load(memory_order_acquire);
+		if (again == latest) {
+			return snapshot;
+		}
+		latest = again;
+	}
+	return nullptr;
+}
+
+
+Etale::Etale(const vector<vector<uint8_t>>& parts, const int64_t t_out, const int64_t t_in, const bool paused)
+: paused {paused}, parts_copied {false}, conflated {false}, conflated_bytes_num {0}, conflated_t_out {-1}, conflated_replayed {false}, snapshots {make_shared<SnapshotSlot>()}, counters {make_shared<RecvCounters>()}, keyframe_num {-1}, chunks_t_out {-1}, chunks_num {0}, chunks_next_index {0}, chunks_bytes_num {0}, t_out {t_out}, t_in {t_in} {
+	for (const auto& part : parts) {
+		this->zparts.emplace_back(part.data(), part.size());
+	}
+}
+
+
+const vector<Epart>& Etale::eparts() const {
+	return this->zparts;
+}
+
+
+const vector<vector<uint8_t>>& Etale::parts() const {
+	if (!this->parts_copied) {
+		// Reuses previous vectors, so same-size parts cause no allocation
+		this->parts_copy.resize(this->zparts.size());
+		for (size_t i = 0; i < this->zparts.size(); i++) {
+			this->parts_copy[i].assign(this->zparts[i].data(), this->zparts[i].data() + this->zparts[i].size());
+		}
+		this->parts_copied = true;
+	}
+	return this->parts_copy;
+}
+
+
+RecvStats Etale::stats() const {
+	return this->counters->load();
+}
+
+
+const string& Etale::title() const {
+	return this->msg_title;
+}
+
+
+// Word at a time, multiplicative; folded so that low bits, which select slot, depend on all bits
+uint64_t title_hash(const char* title, const size_t title_len) {
+	uint64_t hash = 0xCBF29CE484222325ULL ^ title_len;
+	size_t i = 0;
+	for (; i + 8 <= title_len; i += 8) {
+		uint64_t word;
+		memcpy(&word, title + i, 8);
+		hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+		hash ^= hash >> 29;
+	}
+	uint64_t tail = 0;
+	memcpy(&tail, title + i, title_len - i);
+	hash = (hash ^ tail) * 0x9E3779B97F4A7C15ULL;
+	return hash ^ (hash >> 32);
+}
+
+
+Etable::Etable()
+: slots(MIN_SLOTS_NUM, EMPTY_SLOT), etales_num {0}, used_slots_num {0} {
+}
+
+
+// Slot of present title or, if absent, SIZE_MAX
+size_t Etable::find_slot(const char* title, const size_t title_len) const {
+	size_t mask = this->slots.size() - 1;
+	for (size_t i = title_hash(title, title_len) & mask; this->slots[i] != EMPTY_SLOT; i = (i + 1) & mask) {
+		if (this->slots[i] != DELETED_SLOT) {
+			const string& that_title = this->entries[this->slots[i] - SLOT_INDEX_BASE].title;
+			if ((that_title.size() == title_len) && (memcmp(that_title.data(), title, title_len) == 0)) {
+				return i;
+			}
+		}
+	}
+	return SIZE_MAX;
+}
+
+
+void Etable::rehash(const size_t slots_num) {
+	this->slots.assign(slots_num, EMPTY_SLOT);
+	size_t mask = slots_num - 1;
+	for (size_t j = 0; j < this->entries.size(); j++) {
+		const Entry& entry = this->entries[j];
+		if (entry.etale) {
+			size_t i = title_hash(entry.title.data(), entry.title.size()) & mask;
+			while (this->slots[i] != EMPTY_SLOT) {
+				i = (i + 1) & mask;
+			}
+			this->slots[i] = SLOT_INDEX_BASE + uint32_t(j);
+		}
+	}
+	this->used_slots_num = this->etales_num;
+}
+
+
+Etale* Etable::find(const char* title, const size_t title_len) const {
+	size_t i = this->find_slot(title, title_len);
+	return (i != SIZE_MAX) ? this->entries[this->slots[i] - SLOT_INDEX_BASE].etale.get() : nullptr;
+}
+
+
+Etale* Etable::find(const string& title) const {
+	return this->find(title.data(), title.size());
+}
+
+
+Etale* Etable::find(const EtaleId& id) const {
+	if ((id.index < this->entries.size()) && (this->entries[id.index].generation == id.generation)) {
+		return this->entries[id.index].etale.get(); // nullptr if deleted but not yet reused
+	} else {
+		return nullptr;
+	}
+}
+
+
+tuple<EtaleId, bool> Etable::find_id(const string& title) const {
+	size_t i = this->find_slot(title.data(), title.size());
+	if (i != SIZE_MAX) {
+		uint32_t index = this->slots[i] - SLOT_INDEX_BASE;
+		return tuple<EtaleId, bool>{EtaleId{index, this->entries[index].generation}, true};
+	} else {
+		return tuple<EtaleId, bool>{EtaleId{UINT32_MAX, 0}, false};
+	}
+}
+
+
+tuple<Etale&, bool> Etable::emplace(const string& title) {
+	size_t i = this->find_slot(title.data(), title.size());
+	if (i != SIZE_MAX) {
+		return tuple<Etale&, bool>{*(this->entries[this->slots[i] - SLOT_INDEX_BASE].etale), false};
+	}
+
+	// Keep load factor, incl. deleted slots, at most 3/4
+	if (4 * (this->used_slots_num + 1) > 3 * this->slots.size()) {
+		this->rehash((4 * (this->etales_num + 1) > this->slots.size()) ? (2 * this->slots.size()) : this->slots.size());
+	}
+
+	uint32_t index;
+	if (!this->free_indices.empty()) {
+		index = this->free_indices.back();
+		this->free_indices.pop_back();
+	} else {
+		index = uint32_t(this->entries.size());
+		this->entries.emplace_back();
+		this->entries.back().generation = 0;
+	}
+	Entry& entry = this->entries[index];
+	entry.title = title;
+	entry.etale.reset(new Etale());
+
+	size_t mask = this->slots.size() - 1;
+	i = title_hash(title.data(), title.size()) & mask;
+	while ((this->slots[i] != EMPTY_SLOT) && (this->slots[i] != DELETED_SLOT)) {
+		i = (i + 1) & mask;
+	}
+	if (this->slots[i] == EMPTY_SLOT) {
+		this->used_slots_num++;
+	}
+	this->slots[i] = SLOT_INDEX_BASE + index;
+	this->etales_num++;
+
+	return tuple<Etale&, bool>{*(entry.etale), true};
+}
+
+
+bool Etable::erase(const string& title) {
+	size_t i = this->find_slot(title.data(), title.size());
+	if (i == SIZE_MAX) {
+		return false;
+	}
+	uint32_t index = this->slots[i] - SLOT_INDEX_BASE;
+	this->slots[i] = DELETED_SLOT;
+	Entry& entry = this->entries[index];
+	entry.etale.reset();
+	entry.title.clear();
+	entry.generation++; // stale handles no longer match
+	this->free_indices.push_back(index);
+	this->etales_num--;
+	return true;
+}
+
+
+Etrie::Etrie()
+: nodes(1), etales_num {0} {
+}
+
+
+uint32_t Etrie::child(const uint32_t index, const uint8_t byte) const {
+	for (const auto& child : this->nodes[index].children) {
+		if (child.first == byte) {
+			return child.second;
+		}
+	}
+	return UINT32_MAX;
+}
+
+
+uint32_t Etrie::find_node(const string& prefix) const {
+	uint32_t index = 0;
+	for (size_t i = 0; (i < prefix.size()) && (index != UINT32_MAX); i++) {
+		index = this->child(index, uint8_t(prefix[i]));
+	}
+	return index;
+}
+
+
+bool Etrie::empty() const {
+	return this->etales_num == 0;
+}
+
+
+Etale* Etrie::find(const string& prefix) const {
+	uint32_t index = this->find_node(prefix);
+	return (index != UINT32_MAX) ? this->nodes[index].etale.get() : nullptr;
+}
+
+
+Etale* Etrie::find_longest(const char* title, const size_t title_len) const {
+	Etale* etale = this->nodes[0].etale.get();
+	uint32_t index = 0;
+	for (size_t i = 0; i < title_len; i++) {
+		index = this->child(index, uint8_t(title[i]));
+		if (index == UINT32_MAX) {
+			break;
+		}
+		if (this->nodes[index].etale) {
+			etale = this->nodes[index].etale.get();
+		}
+	}
+	return etale;
+}
+
+
+tuple<Etale&, bool> Etrie::emplace(const string& prefix) {
+	uint32_t index = 0;
+	for (size_t i = 0; i < prefix.size(); i++) {
+		uint8_t byte = uint8_t(prefix[i]);
+		uint32_t next = this->child(index, byte);
+		if (next == UINT32_MAX) {
+			if (!this->free_indices.empty()) {
+				next = this->free_indices.back();
+				this->free_indices.pop_back();
+			} else {
+				next = uint32_t(this->nodes.size());
+				this->nodes.emplace_back(); // may move nodes, but not etales
+			}
+			auto& children = this->nodes[index].children;
+			auto it = children.begin();
+			while ((it != children.end()) && (it->first < byte)) {
+				it++;
+			}
+			children.insert(it, pair<uint8_t, uint32_t>(byte, next));
+		}
+		index = next;
+	}
+	Node& node = this->nodes[index];
+	if (node.etale) {
+		return tuple<Etale&, bool>{*(node.etale), false};
+	}
+	node.etale.reset(new Etale());
+	this->etales_num++;
+	return tuple<Etale&, bool>{*(node.etale), true};
+}
+
+
+bool Etrie::erase(const string& prefix) {
+	vector<uint32_t> path{0};
+	for (size_t i = 0; (i < prefix.size()) && (path.back() != UINT32_MAX); i++) {
+		path.push_back(this->child(path.back(), uint8_t(prefix[i])));
+	}
+	if ((path.back() == UINT32_MAX) || !this->nodes[path.back()].etale) {
+		return false;
+	}
+	this->nodes[path.back()].etale.reset();
+	this->etales_num--;
+	// Nodes left with neither etale nor children are freed, up to root
+	for (size_t i = prefix.size(); i > 0; i--) {
+		Node& node = this->nodes[path[i]];
+		if (node.etale || !node.children.empty()) {
+			break;
+		}
+		auto& children = this->nodes[path[i - 1]].children;
+		for (auto it = children.begin(); it != children.end(); it++) {
+			if (it->second == path[i]) {
+				children.erase(it);
+				break;
+			}
+		}
+		this->free_indices.push_back(path[i]);
+	}
+	return true;
+}
+
+
+Ehypha::Ehypha(zcontext* context, mutex* io_mutex, const string& secretkey, const string& publickey, const string& serverkey, const string& endpoint, const string& socks_proxy, const bool monitored)
+: serverkey {serverkey}, monsock {nullptr}, io_mutex {io_mutex}, snapshotting {false}, conflating {false}, max_reassembled_len {DEF_MAX_REASSEMBLED_LEN}, counters {make_shared<RecvCounters>()}, out_counters {make_shared<OutCounters>()} {
+	this->subsock = zmq_socket(context, ZMQ_SUB);
+	zmqe_setsockopt(this->subsock, ZMQ_SNDHWM, 0); // outgoing messages of SUB socket are (un)subscriptions, which must not be dropped even if there are thousands of etales
+	zmqe_setsockopt(this->subsock, ZMQ_CURVE_SECRETKEY, secretkey.c_str());
+	zmqe_setsockopt(this->subsock, ZMQ_CURVE_PUBLICKEY, publickey.c_str());
+	zmqe_setsockopt(this->subsock, ZMQ_CURVE_SERVERKEY, serverkey.c_str());
+	if (!socks_proxy.empty()) {
+		zmqe_setsockopt(this->subsock, ZMQ_SOCKS_PROXY, socks_proxy.c_str());
+	}
+	if (monitored) {
+		this->start_monitor(context); // before connecting, not to miss events
+	}
+	zmq_connect(this->subsock, endpoint.c_str());
+}
+
+
+tuple<const Etale&, EW> Ehypha::add_etale(const string& title) {
+	lock_guard<mutex> io_lock(*this->io_mutex);
+	auto res = this->etales.emplace(title);
+	Etale& etale = get<0>(res);
+	if (get<1>(res)) {
+		zmqe_setsockopt(this->subsock, ZMQ_SUBSCRIBE, title.c_str());
+		this->warm_up(etale, false, title);
+		if (this->snapshotting) {
+			this->publish_snapshot(etale);
+		}
+		return tuple<const Etale&, EW>{etale, EW::Ok};
+	} else {
+		return tuple<const Etale&, EW>{etale, EW::AlreadyPresent};
+	}
+}
+
+
+tuple<const Etale*, EW> Ehypha::get_etale_ptr(const string& title) {
+	const Etale* etale = this->etales.find(title);
+	return tuple<const Etale*, EW>{etale, (etale != nullptr) ? EW::Ok : EW::Absent};
+}
+
+
+tuple<shared_ptr<const Etale>, EW> Ehypha::get_etale_snapshot(const string& title) {
+	const Etale* etale = this->etales.find(title);
+	if (etale != nullptr) {
+		return tuple<shared_ptr<const Etale>, EW>{etale->snapshots->acquire(), EW::Ok};
+	} else {
+		return tuple<shared_ptr<const Etale>, EW>{nullptr, EW::Absent};
+	}
+}
+
+
+tuple<EtaleId, EW> Ehypha::get_etale_id(const string& title) {
+	auto res = this->etales.find_id(title);
+	return tuple<EtaleId, EW>{get<0>(res), get<1>(res) ? EW::Ok : EW::Absent};
+}
+
+
+tuple<const Etale*, EW> Ehypha::get_etale_ptr(const EtaleId& id) {
+	const Etale* etale = this->etales.find(id);
+	return tuple<const Etale*, EW>{etale, (etale != nullptr) ? EW::Ok : EW::Absent};
+}
+
+
+tuple<shared_ptr<const Etale>, EW> Ehypha::get_etale_snapshot(const EtaleId& id) {
+	const Etale* etale = this->etales.find(id);
+	if (etale != nullptr) {
+		return tuple<shared_ptr<const Etale>, EW>{etale->snapshots->acquire(), EW::Ok};
+	} else {
+		return tuple<shared_ptr<const Etale>, EW>{nullptr, EW::Absent};
+	}
+}
+
+
+EW Ehypha::del_etale(const string& title) {
+	lock_guard<mutex> io_lock(*this->io_mutex);
+	if (this->etales.erase(title)) {
+		zmqe_setsockopt(this->subsock, ZMQ_UNSUBSCRIBE, title.c_str());
+		return EW::Ok;
+	} else {
+		return EW::AlreadyAbsent;
+	}
+}
+
+
+tuple<const Etale&, EW> Ehypha::add_etale_prefix(const string& prefix) {
+	lock_guard<mutex> io_lock(*this->io_mutex);
+	auto res = this->prefix_etales.emplace(prefix);
+	Etale& etale = get<0>(res);
+	if (get<1>(res)) {
+		zmq_setsockopt(this->subsock, ZMQ_SUBSCRIBE, prefix.data(), prefix.size()); // without terminating zero byte, unlike exact title
+		this->warm_up(etale, true, prefix);
+		if (this->snapshotting) {
+			this->publish_snapshot(etale);
+		}
+		return tuple<const Etale&, EW>{etale, EW::Ok};
+	} else {
+		return tuple<const Etale&, EW>{etale, EW::AlreadyPresent};
+	}
+}
+
+
+tuple<const Etale*, EW> Ehypha::get_etale_prefix_ptr(const string& prefix) {
+	const Etale* etale = this->prefix_etales.find(prefix);
+	return tuple<const Etale*, EW>{etale, (etale != nullptr) ? EW::Ok : EW::Absent};
+}
+
+
+tuple<shared_ptr<const Etale>, EW> Ehypha::get_etale_prefix_snapshot(const string& prefix) {
+	const Etale* etale = this->prefix_etales.find(prefix);
+	if (etale != nullptr) {
+		return tuple<shared_ptr<const Etale>, EW>{etale->snapshots->acquire(), EW::Ok};
+	} else {
+		return tuple<shared_ptr<const Etale>, EW>{nullptr, EW::Absent};
+	}
+}
+
+
+EW Ehypha::del_etale_prefix(const string& prefix) {
+	lock_guard<mutex> io_lock(*this->io_mutex);
+	const Etale* etale = this->prefix_etales.find(prefix);
+	if (etale != nullptr) {
+		if (!etale->paused) {
+			zmq_setsockopt(this->subsock, ZMQ_UNSUBSCRIBE, prefix.data(), prefix.size());
+		}
+		this->prefix_etales.erase(prefix);
+		return EW::Ok;
+	} else {
+		return EW::AlreadyAbsent;
+	}
+}
+
+
+EW Ehypha::pause_etale(const string& title) {
+	lock_guard<mutex> io_lock(*this->io_mutex);
+	Etale* etale = this->etales.find(title);
+	if (etale != nullptr) {
+		if (!etale->paused) {
+			zmqe_setsockopt(this->subsock, ZMQ_UNSUBSCRIBE, title.c_str());
+			etale->paused = true;
+			return EW::Ok;
+		} else {
+			return EW::AlreadyPaused;
+		}
+	} else {
+		return EW::Absent;
+	}
+}
+
+
+EW Ehypha::resume_etale(const string& title) {
+	lock_guard<mutex> io_lock(*this->io_mutex);
+	Etale* etale = this->etales.find(title);
+	if (etale != nullptr) {
+		if (etale->paused) {
+			zmqe_setsockopt(this->subsock, ZMQ_SUBSCRIBE, title.c_str());
+			etale->paused = false;
+			return EW::Ok;
+		} else {
+			return EW::AlreadyResumed;
+		}
+	} else {
+		return EW::Absent;
+	}
+}
+
+
+void Ehypha::pause_etales() {
+	vector<string> titles;
+	this->etales.for_each([&titles](const string& title, Etale&) { titles.push_back(title); });
+	for (const auto& title : titles) {
+		this->pause_etale(title);
+	}
+	lock_guard<mutex> io_lock(*this->io_mutex);
+	this->prefix_etales.for_each([this](const string& prefix, Etale& etale) {
+		if (!etale.paused) {
+			zmq_setsockopt(this->subsock, ZMQ_UNSUBSCRIBE, prefix.data(), prefix.size());
+			etale.paused = true;
+		}
+	});
+}
+
+void Ehypha::resume_etales() {
+	vector<string> titles;
+	this->etales.for_each([&titles](const string& title, Etale&) { titles.push_back(title); });
+	for (const auto& title : titles) {
+		this->resume_etale(title);
+	}
+	lock_guard<mutex> io_lock(*this->io_mutex);
+	this->prefix_etales.for_each([this](const string& prefix, Etale& etale) {
+		if (etale.paused) {
+			zmq_setsockopt(this->subsock, ZMQ_SUBSCRIBE, prefix.data(), prefix.size());
+			etale.paused = false;
+		}
+	});
+}
+
+
+void Ehypha::update() {
+	int64_t t = time_musec();
+
+	vector<Epart>& msg_parts = this->recv_parts; // its capacity is kept, so receiving does not allocate
+	while ((zmqe_getsockopt_events(this->subsock) & ZMQ_POLLIN) != 0) {
+		msg_parts.clear();
+		size_t bytes_num = 0;
+		do {
+			msg_parts.emplace_back();
+			zmq_msg_recv(msg_parts.back().zmsg(), this->subsock, 0);
+			bytes_num += msg_parts.back().size();
+		} while (zmq_msg_more(msg_parts.back().zmsg()));
+		// 0th is topic, 1st is remote time, optionally followed by codec of each part and then by keyframe reference, rest (optional) is data
+		const bool topic_ok = (msg_parts.size() >= 2) && (msg_parts[0].size() >= 1) && (msg_parts[0].data()[msg_parts[0].size() - 1] == 0);
+		const char* title = (const char *)msg_parts[0].data();
+		const size_t title_len = topic_ok ? strnlen(title, msg_parts[0].size()) : 0; // title ends at 1st zero
+		Etale* etale = topic_ok ? this->etales.find(title, title_len) : nullptr;
+		if ((etale == nullptr) && topic_ok && !this->prefix_etales.empty()) {
+			etale = this->prefix_etales.find_longest(title, title_len);
+		}
+		const bool paused = (etale != nullptr) && etale->paused;
+		// Or 1st is remote time followed by chunk header, and 2nd is chunk; once all chunks have arrived, they become entire message, as if received at once
+		const bool chunk = topic_ok && (msg_parts.size() == 3) && (msg_parts[1].size() == 8 + CHUNK_HEADER_LEN);
+		if (chunk && (etale != nullptr) && !paused) {
+			bool malformed = false;
+			if (!this->reassemble(*etale, bytes_num, malformed)) {
+				if (malformed) {
+					this->counters->count(t, bytes_num, false, -1, false, false, false);
+					etale->counters->count(t, bytes_num, false, -1, false, false, false);
+				}
+				continue;
+			}
+		}
+		const bool time_ok = topic_ok && ((msg_parts[1].size() == 8) || (msg_parts[1].size() == 8 + msg_parts.size() - 2) || (msg_parts[1].size() == 8 + msg_parts.size() - 2 + KEYFRAME_REF_LEN) || (chunk && ((etale == nullptr) || paused)));
+		int64_t t_out = -1;
+		if (time_ok) {
+			memcpy(&t_out, msg_parts[1].data(), 8);
+		}
+		// Replayed by last-value cache of publisher for some new subscriber, so others may have it already
+		const bool replayed = time_ok && (msg_parts[0].size() == title_len + 3) && (msg_parts[0].data()[title_len + 1] == REPLAY_MARK);
+		const bool stale = replayed && (etale != nullptr) && (t_out <= (etale->conflated_parts.empty() ? etale->t_out : etale->conflated_t_out));
+		// Of conflating ehypha, message other than keyframe waits till drain ends, so that it is unpacked only unless superseded by then
+		bool keyframe = false;
+		if (time_ok && (msg_parts[1].size() == 8 + msg_parts.size() - 2 + KEYFRAME_REF_LEN)) {
+			uint32_t keyframe_ref = 0;
+			memcpy(&keyframe_ref, msg_parts[1].data() + msg_parts[1].size() - KEYFRAME_REF_LEN, KEYFRAME_REF_LEN);
+			keyframe = (keyframe_ref & KEYFRAME_BIT) != 0;
+		}
+		if (this->conflating && time_ok && (etale != nullptr) && !paused && !stale && !keyframe) {
+			if (!etale->conflated_parts.empty()) {
+				this->supersede_conflated(*etale, t);
+			}
+			etale->conflated_parts.swap(msg_parts); // keeps capacity of both
+			etale->conflated_bytes_num = bytes_num;
+			etale->conflated_t_out = t_out;
+			etale->conflated_replayed = replayed;
+			if (!etale->conflated) {
+				etale->conflated = true;
+				this->conflated_etales.push_back(etale);
+			}
+			continue;
+		}
+		// Parts are decompressed only for etales that take them
+		bool unbased = false;
+		const bool parts_ok = time_ok && ((msg_parts[1].size() == 8) || (etale == nullptr) || paused || stale || this->unpack_parts(*etale, unbased));
+		this->counters->count(t, bytes_num, parts_ok || unbased, t_out, paused, unbased, replayed);
+		if (etale != nullptr) {
+			etale->counters->count(t, bytes_num, parts_ok || unbased, t_out, paused, unbased, replayed);
+			if (parts_ok && !paused && !stale) {
+				if (!etale->conflated_parts.empty()) {
+					this->supersede_conflated(*etale, t);
+				}
+				this->take_parts(*etale, t_out, t);
+				if (this->conflating) {
+					if (!etale->conflated) {
+						etale->conflated = true;
+						this->conflated_etales.push_back(etale);
+					}
+				} else if (this->snapshotting) {
+					this->publish_snapshot(*etale);
+				}
+			}
+		}
+	}
+
+	for (Etale* etale : this->conflated_etales) {
+		if (!etale->conflated_parts.empty()) {
+			msg_parts.swap(etale->conflated_parts);
+			etale->conflated_parts.clear();
+			bool unbased = false;
+			const bool parts_ok = (msg_parts[1].size() == 8) || this->unpack_parts(*etale, unbased);
+			this->counters->count(t, etale->conflated_bytes_num, parts_ok || unbased, etale->conflated_t_out, false, unbased, etale->conflated_replayed);
+			etale->counters->count(t, etale->conflated_bytes_num, parts_ok || unbased, etale->conflated_t_out, false, unbased, etale->conflated_replayed);
+			if (parts_ok) {
+				this->take_parts(*etale, etale->conflated_t_out, t);
+			}
+		}
+		if (this->snapshotting) {
+			this->publish_snapshot(*etale);
+		}
+		etale->conflated = false;
+	}
+	this->conflated_etales.clear();
+	msg_parts.clear(); // drops superseded frames now rather than at next drain
+}
+
+
+void Ehypha::take_parts(Etale& etale, const int64_t t_out, const int64_t t_in) {
+	vector<Epart>& msg_parts = this->recv_parts;
+	etale.zparts.clear();
+	for (size_t i = 2; i < msg_parts.size(); i++) {
+		etale.zparts.emplace_back(move(msg_parts[i]));
+	}
+	etale.parts_copied = false;
+	const char* title = (const char *)msg_parts[0].data();
+	etale.msg_title.assign(title, strnlen(title, msg_parts[0].size())); // keeps capacity
+	etale.t_out = t_out;
+	etale.t_in = t_in;
+}
+
+
+void Ehypha::supersede_conflated(Etale& etale, const int64_t t) {
+	this->counters->count(t, etale.conflated_bytes_num, true, etale.conflated_t_out, false, false, etale.conflated_replayed);
+	etale.counters->count(t, etale.conflated_bytes_num, true, etale.conflated_t_out, false, false, etale.conflated_replayed);
+	etale.conflated_parts.clear();
+}
+
+
+bool Ehypha::reassemble(Etale& etale, size_t& bytes_num, bool& malformed) {
+	vector<Epart>& msg_parts = this->recv_parts;
+	int64_t t_out = -1;
+	uint32_t index = 0;
+	uint32_t chunks_num = 0;
+	memcpy(&t_out, msg_parts[1].data(), 8);
+	memcpy(&index, msg_parts[1].data() + 8, 4);
+	memcpy(&chunks_num, msg_parts[1].data() + 12, 4);
+	if (index == 0) {
+		if (etale.chunks_num != 0) { // previous etale is still incomplete, so its last chunks were lost
+			this->drop_chunks(etale, etale.chunks_next_index, etale.chunks_bytes_num);
+		}
+		etale.chunks.clear(); // keeps capacity for next etale
+		etale.chunks_t_out = t_out;
+		etale.chunks_num = chunks_num;
+		etale.chunks_next_index = 0;
+		etale.chunks_bytes_num = 0;
+	}
+	if ((index != etale.chunks_next_index) || (t_out != etale.chunks_t_out) || (chunks_num != etale.chunks_num) || (chunks_num == 0)) {
+		// Some chunk was lost (dropped by queue limit), so the rest is ignored until next etale, and so are chunks collected so far
+		const bool collecting = etale.chunks_num != 0;
+		this->drop_chunks(etale, (collecting ? etale.chunks_next_index : 0) + 1, (collecting ? etale.chunks_bytes_num : 0) + bytes_num);
+		etale.chunks_num = 0;
+		return false;
+	}
+	// All chunks but last are as long as 1st one
+	if (((index == 0) && (uint64_t(chunks_num - 1) * msg_parts[2].size() > this->max_reassembled_len)) || (etale.chunks.size() + msg_parts[2].size() > this->max_reassembled_len)) {
+		vector<uint8_t>().swap(etale.chunks);
+		etale.chunks_num = 0;
+		bytes_num += etale.chunks_bytes_num;
+		malformed = true;
+		return false;
+	}
+	etale.chunks.insert(etale.chunks.end(), msg_parts[2].data(), msg_parts[2].data() + msg_parts[2].size());
+	etale.chunks_bytes_num += bytes_num;
+	etale.chunks_next_index++;
+	if (etale.chunks_next_index < chunks_num) {
+		return false;
+	}
+	etale.chunks_num = 0;
+	bytes_num = etale.chunks_bytes_num;
+
+	// Serialized etale: length of time tail, time tail (codecs etc.), number of parts, their lengths, their data
+	const uint8_t* data = etale.chunks.data();
+	const size_t len = etale.chunks.size();
+	size_t i = 0;
+	uint32_t time_tail_len = 0;
+	uint32_t parts_num = 0;
+	if (len < 4) {
+		malformed = true;
+		return false;
+	}
+	memcpy(&time_tail_len, data, 4);
+	i += 4;
+	if ((time_tail_len > len - i) || (len - i - time_tail_len < 4)) {
+		malformed = true;
+		return false;
+	}
+	Epart time(8 + size_t(time_tail_len));
+	memcpy(zmq_msg_data(time.zmsg()), &t_out, 8);
+	memcpy((uint8_t*)zmq_msg_data(time.zmsg()) + 8, data + i, time_tail_len);
+	i += time_tail_len;
+	memcpy(&parts_num, data + i, 4);
+	i += 4;
+	if (parts_num > (len - i) / 8) {
+		malformed = true;
+		return false;
+	}
+	const size_t lens_offset = i;
+	size_t parts_len = 0;
+	for (uint32_t j = 0; j < parts_num; j++) {
+		uint64_t part_len = 0;
+		memcpy(&part_len, data + lens_offset + 8 * j, 8);
+		if (part_len > len) {
+			malformed = true;
+			return false;
+		}
+		parts_len += part_len;
+	}
+	i += 8 * size_t(parts_num);
+	if (parts_len != len - i) {
+		malformed = true;
+		return false;
+	}
+
+	msg_parts.resize(2); // topic stays
+	msg_parts[1] = move(time);
+	for (uint32_t j = 0; j < parts_num; j++) {
+		uint64_t part_len = 0;
+		memcpy(&part_len, data + lens_offset + 8 * j, 8);
+		msg_parts.emplace_back(data + i, size_t(part_len));
+		i += part_len;
+	}
+	return true;
+}
+
+
+void Ehypha::drop_chunks(Etale& etale, const uint64_t chunks_num, const size_t bytes_num) {
+	this->counters->drop_chunks(chunks_num, bytes_num);
+	etale.counters->drop_chunks(chunks_num, bytes_num);
+}
+
+
+bool Ehypha::unpack_parts(Etale& etale, bool& unbased) {
+	vector<Epart>& msg_parts = this->recv_parts;
+	const size_t parts_num = msg_parts.size() - 2;
+	const uint8_t* codecs = msg_parts[1].data() + 8;
+	int64_t keyframe_num = -1;
+	bool keyframe = false;
+	if (msg_parts[1].size() == 8 + parts_num + KEYFRAME_REF_LEN) {
+		uint32_t keyframe_ref = 0;
+		memcpy(&keyframe_ref, codecs + parts_num, KEYFRAME_REF_LEN);
+		keyframe_num = keyframe_ref & ~KEYFRAME_BIT;
+		keyframe = (keyframe_ref & KEYFRAME_BIT) != 0;
+	}
+
+	for (size_t i = 0; i < parts_num; i++) {
+		Epart& packed = msg_parts[2 + i];
+		switch (Ecodec(codecs[i])) {
+			case Ecodec::Raw:
+				break;
+			case Ecodec::Rle: {
+				size_t len = rle_unpacked_len(packed.data(), packed.size());
+				if (len == SIZE_MAX) {
+					return false;
+				}
+				Epart part(len);
+				if (!rle_unpack(packed.data(), packed.size(), (uint8_t*)zmq_msg_data(part.zmsg()), len)) {
+					return false;
+				}
+				packed = move(part);
+				break;
+			}
+			case Ecodec::XorRle: {
+				if ((keyframe_num < 0) || keyframe) {
+					return false;
+				}
+				if ((keyframe_num != etale.keyframe_num) || (i >= etale.keyframe_parts.size())) {
+					unbased = true; // keyframe was missed, or arrived while etale was paused
+					return false;
+				}
+				const Epart& base = etale.keyframe_parts[i];
+				size_t len = rle_unpacked_len(packed.data(), packed.size());
+				if (len != base.size()) {
+					return false;
+				}
+				Epart part(len);
+				uint8_t* data = (uint8_t*)zmq_msg_data(part.zmsg());
+				if (!rle_unpack(packed.data(), packed.size(), data, len)) {
+					return false;
+				}
+				const uint8_t* base_data = base.data();
+				for (size_t j = 0; j < len; j++) {
+					data[j] ^= base_data[j];
+				}
+				packed = move(part);
+				break;
+			}
+			default:
+				return false;
+		}
+	}
+
+	if (keyframe) {
+		etale.keyframe_parts.assign(msg_parts.begin() + 2, msg_parts.end()); // shares frames, see Epart
+		etale.keyframe_num = keyframe_num;
+	}
+	return true;
+}
+
+
+void Ehypha::publish_snapshot(Etale& etale) {
+	// Snapshot held by no reader anymore, only by slot, is reused, with capacity of its vectors, unless it is the latest; others of such drop their parts
+	SnapshotSlot& slot = *etale.snapshots;
+	const shared_ptr<Etale>* latest = slot.latest.load(memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst); // pairs with fence in SnapshotSlot::acquire(), so reader of superseded snapshot either sees newer one or is seen here
+	shared_ptr<Etale>* snapshot = nullptr;
+	for (auto& spare : slot.snapshots) {
+		if ((&spare != latest) && (spare.use_count() == 1)) {
+			atomic_thread_fence(memory_order_acquire); // pairs with release of last reader
+			if (snapshot == nullptr) {
+				snapshot = &spare;
+			} else {
+				spare->zparts.clear();
+			}
+		}
+	}
+	if (snapshot == nullptr) {
+		slot.snapshots.push_back(make_shared<Etale>());
+		snapshot = &slot.snapshots.back();
+	}
+
+	Etale& dst = **snapshot;
+	dst.paused = etale.paused;
+	dst.zparts = etale.zparts; // parts are shared, not copied, see Epart
+	dst.parts_copied = false;
+	dst.counters = etale.counters;
+	dst.msg_title = etale.msg_title;
+	dst.t_out = etale.t_out;
+	dst.t_in = etale.t_in;
+	slot.latest.store(snapshot, memory_order_seq_cst);
+}
+
+
+void Ehypha::set_snapshotting(const bool snapshotting) {
+	this->snapshotting = snapshotting;
+	if (snapshotting) {
+		this->etales.for_each([this](const string&, Etale& etale) { this->publish_snapshot(etale); });
+		this->prefix_etales.for_each([this](const string&, Etale& etale) { this->publish_snapshot(etale); });
+	}
+}
+
+
+void Ehypha::set_warm_snapshot(const shared_ptr<WarmSnapshot>& warm_snapshot) {
+	this->warm_snapshot = warm_snapshot;
+	auto warm_up_etale = [this](const bool prefix, const string& title, Etale& etale) {
+		if (etale.t_in < 0) {
+			this->warm_up(etale, prefix, title);
+			if (this->snapshotting) {
+				this->publish_snapshot(etale);
+			}
+		}
+	};
+	this->etales.for_each([&warm_up_etale](const string& title, Etale& etale) { warm_up_etale(false, title, etale); });
+	this->prefix_etales.for_each([&warm_up_etale](const string& prefix, Etale& etale) { warm_up_etale(true, prefix, etale); });
+}
+
+
+void Ehypha::warm_up(Etale& etale, const bool prefix, const string& title) {
+	if (!this->warm_snapshot || (etale.t_in >= 0)) {
+		return;
+	}
+	const WarmSnapshot& snap = *this->warm_snapshot;
+	size_t offset = snap.find(this->serverkey + (prefix ? SNAPSHOT_KIND_PREFIX : SNAPSHOT_KIND_TITLE) + title);
+	if (offset == SIZE_MAX) {
+		return;
+	}
+	const uint8_t* record = snap.data + offset;
+	const size_t record_len = snap.len - offset; // at least header and key, see find()
+	int64_t t_out = -1;
+	int64_t t_in = -1;
+	uint32_t key_len = 0;
+	uint32_t msg_title_len = 0;
+	uint32_t parts_num = 0;
+	memcpy(&t_out, record, 8);
+	memcpy(&t_in, record + 8, 8);
+	memcpy(&key_len, record + 16, 4);
+	memcpy(&msg_title_len, record + 20, 4);
+	memcpy(&parts_num, record + 24, 4);
+	size_t i = SNAPSHOT_RECORD_HEADER_LEN + key_len;
+	if ((msg_title_len > record_len - i) || (parts_num > (record_len - i - msg_title_len) / 8)) {
+		return;
+	}
+	const char* msg_title = (const char*)(record + i);
+	i = (i + msg_title_len + 7) & ~size_t(7);
+	size_t lens_offset = i;
+	i += 8 * size_t(parts_num);
+	if (i > record_len) {
+		return;
+	}
+	for (uint32_t j = 0; j < parts_num; j++) {
+		uint64_t part_len = 0;
+		memcpy(&part_len, record + lens_offset + 8 * j, 8);
+		if (part_len > record_len - i) {
+			return;
+		}
+		i = min((i + size_t(part_len) + 7) & ~size_t(7), record_len);
+	}
+
+	etale.zparts.clear();
+	i = lens_offset + 8 * size_t(parts_num);
+	for (uint32_t j = 0; j < parts_num; j++) {
+		uint64_t part_len = 0;
+		memcpy(&part_len, record + lens_offset + 8 * j, 8);
+		if (part_len < MIN_ZEROCOPY_PART_LEN) {
+			etale.zparts.emplace_back(record + i, size_t(part_len));
+		} else {
+			// Refers to mapped file, which thus stays mapped as long as the part
+			etale.zparts.emplace_back();
+			zmq_msg_close(etale.zparts.back().zmsg());
+			zmq_msg_init_data(etale.zparts.back().zmsg(), (void*)(record + i), size_t(part_len), zmqe_free_warm_snapshot, new shared_ptr<WarmSnapshot>(this->warm_snapshot));
+		}
+		i = (i + size_t(part_len) + 7) & ~size_t(7);
+	}
+	etale.parts_copied = false;
+	etale.msg_title.assign(msg_title, msg_title_len);
+	etale.t_out = t_out;
+	etale.t_in = t_in;
+}
+
+
+void Ehypha::set_conflating(const bool conflating) {
+	lock_guard<mutex> io_lock(*this->io_mutex);
+	this->conflating = conflating;
+}
+
+
+void Ehypha::set_max_reassembled_len(const size_t max_len) {
+	lock_guard<mutex> io_lock(*this->io_mutex);
+	this->max_reassembled_len = max_len;
+}
+
+
+void Ehypha::update_mon() {
+	while ((zmqe_getsockopt_events(this->monsock) & ZMQ_POLLIN) != 0) {
+		vector<vector<uint8_t>> event_msg = zmqe_recv(this->monsock);
+		if ((event_msg.size() > 0) && (event_msg[0].size() >= 6)) {
+			uint16_t event_num = *((uint16_t *)(event_msg[0].data()));
+			uint32_t event_value = 0;
+			memcpy(&event_value, event_msg[0].data() + 2, 4);
+			OutCounters& counters = *(this->out_counters);
+			if (event_num & ZMQ_EVENT_CONNECTED) {
+				add_relaxed(counters.connected_num, 1);
+			}
+			if (event_num & ZMQ_EVENT_CONNECT_RETRIED) {
+				add_relaxed(counters.retried_num, 1);
+				counters.retry_ivl_ms.store(event_value, memory_order_relaxed);
+			}
+			if (event_num & ZMQ_EVENT_HANDSHAKE_SUCCEEDED) {
+				counters.connected.store(true, memory_order_relaxed);
+				counters.t_connected.store(time_musec(), memory_order_relaxed);
+			}
+			if (event_num & (ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL | ZMQ_EVENT_HANDSHAKE_FAILED_PROTOCOL | ZMQ_EVENT_HANDSHAKE_FAILED_AUTH)) {
+				add_relaxed(counters.handshake_failed_num, 1);
+			}
+			if (event_num & ZMQ_EVENT_DISCONNECTED) {
+				add_relaxed(counters.disconnected_num, 1);
+				counters.connected.store(false, memory_order_relaxed);
+				counters.t_disconnected.store(time_musec(), memory_order_relaxed);
+			}
+		}
+	}
+}
+
+
+void Ehypha::start_monitor(zcontext* context) {
+	string mon_endpoint = "inproc://monitor-sub-" + to_string(uintptr_t(this));
+	zmq_socket_monitor(this->subsock, mon_endpoint.c_str(), ZMQ_EVENT_ALL);
+	this->monsock = zmq_socket(context, ZMQ_PAIR);
+	zmq_connect(this->monsock, mon_endpoint.c_str());
+}
+
+
+void Ehypha::stop_monitor() {
+	zmq_socket_monitor(this->subsock, nullptr, 0);
+	zmq_close(this->monsock);
+	this->monsock = nullptr;
+}
+
+
+RecvStats Ehypha::stats() const {
+	return this->counters->load();
+}
+
+
+OutStats Ehypha::out_stats() const {
+	return this->out_counters->load();
+}
+
+
+Ehypha::~Ehypha() {
+	if (this->monsock != nullptr) {
+		zmq_close(this->monsock);
+	}
+	zmq_close(this->subsock);
+}
+
+
+Efunguz::Efunguz(const string& secretkey, const unordered_set<string>& whitelist_publickeys, const uint16_t pubsub_port, const uint16_t torproxy_port, const string& torproxy_host)
+: Efunguz(secretkey, whitelist_publickeys, vector<string>{string("tcp://*:") + to_string(pubsub_port)}, torproxy_port, torproxy_host) {
+}
+
+
+Efunguz::Efunguz(const string& secretkey, const unordered_set<string>& whitelist_publickeys, const vector<string>& pubsub_endpoints, const uint16_t torproxy_port, const string& torproxy_host)
+: pubsub_endpoints {pubsub_endpoints}, torproxy_port {torproxy_port}, torproxy_host {torproxy_host} {
+	this->secretkey = cut_pad_key_str(secretkey);
+
+	char publickey_cstr[KEY_Z85_CSTR_LEN]{0};
+	zmq_curve_public(publickey_cstr, this->secretkey.c_str());
+	this->publickey = cut_pad_key_str(string(publickey_cstr));
+
+	for (const auto& key : whitelist_publickeys) {
+		this->whitelist_publickeys.insert(cut_pad_key_str(key));
+	}
+
+	this->in_accepted_num = 0;
+	this->in_handshake_succeeded_num = 0;
+	this->in_disconnected_num = 0;
+	this->in_handshake_failed_num = 0;
+	this->ehyphae_monitoring = false;
+
+	this->context = zmq_ctx_new();
+	zmq_ctx_set(this->context, ZMQ_IPV6, DEF_IPV6_STATUS);
+	zmq_ctx_set(this->context, ZMQ_BLOCKY, 0);
+	zmq_ctx_set(this->context, ZMQ_MAX_SOCKETS, zmq_ctx_get(this->context, ZMQ_SOCKET_LIMIT)); // default 1023 would limit number of ehyphae
+
+	// At first, REP socket for ZAP auth...
+	this->zapsock = zmq_socket(this->context, ZMQ_REP);
+	zmq_bind(this->zapsock, "inproc://zeromq.zap.01");
+
+	random_device randev;
+	this->zap_session_id.assign(ZAP_SESSION_ID_LEN, 0);
+	for (size_t i = 0; i < ZAP_SESSION_ID_LEN; i++) {
+		this->zap_session_id[i] = randev() & 0xFF; // must be cryptographically random... is it?
+	}
+
+	// ..and only then, PUB socket, as XPUB to see subscriptions, see update_subscriptions()
+	this->pubsock = zmq_socket(this->context, ZMQ_XPUB);
+	zmqe_setsockopt(this->pubsock, ZMQ_CURVE_SERVER, 1);
+	zmqe_setsockopt(this->pubsock, ZMQ_CURVE_SECRETKEY, this->secretkey.c_str());
+	zmq_setsockopt(this->pubsock, ZMQ_ZAP_DOMAIN, ZAP_DOMAIN, strlen(ZAP_DOMAIN)); // to enable auth, must be non-empty due to ZMQ RFC 27
+	zmq_setsockopt(this->pubsock, ZMQ_ROUTING_ID, this->zap_session_id.data(), ZAP_SESSION_ID_LEN); // to make sure only this pubsock can pass auth through zapsock; see update()
+	zmqe_setsockopt(this->pubsock, ZMQ_XPUB_VERBOSER, 1); // all subscriptions and unsubscriptions, incl. repeated ones and those of disconnected subscribers, are passed
+
+	// Before binding, attach monitor
+	zmq_socket_monitor(this->pubsock, "inproc://monitor-pub", ZMQ_EVENT_ALL);
+	this->monsock = zmq_socket(this->context, ZMQ_PAIR);
+	zmq_connect(this->monsock, "inproc://monitor-pub");
+
+	for (const auto& endpoint : this->pubsub_endpoints) {
+		if (is_curve_endpoint(endpoint)) {
+			zmq_bind(this->pubsock, endpoint.c_str());
+		}
+	}
+
+#ifdef __linux__
+	// Sockets themselves serve as tags of ZAP and monitor, ehyphae are tagged by their addresses, see wait_update()
+	this->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	zmqe_epoll_add(this->epoll_fd, this->zapsock, this->zapsock);
+	zmqe_epoll_add(this->epoll_fd, this->monsock, this->monsock);
+	zmqe_epoll_add(this->epoll_fd, this->pubsock, this->pubsock);
+	this->update_zap();
+	this->update_mon();
+#else
+	this->epoll_fd = -1;
+#endif
+
+	this->emitsock = this->pubsock;
+	this->relaysock_app = nullptr;
+	this->relaysock_io = nullptr;
+	this->io_running = false;
+
+	this->emit_chunk_len = 0;
+	this->emit_chunks_rate = 0;
+	this->emit_chunks_refused = false;
+	this->emit_chunks_tokens = 0;
+	this->t_emit_chunks_refill = 0;
+
+	this->emit_caching = false;
+	this->emit_cache_collecting = false;
+	this->emit_cache_pending.reset(new CachedEtale());
+}
+
+
+void Efunguz::add_whitelist_publickeys(const unordered_set<string>& publickeys) {
+	lock_guard<mutex> io_lock(this->io_mutex);
+	for (const auto& key : publickeys) {
+		this->whitelist_publickeys.insert(cut_pad_key_str(key));
+	}
+}
+
+
+void Efunguz::del_whitelist_publickeys(const unordered_set<string>& publickeys) {
+	lock_guard<mutex> io_lock(this->io_mutex);
+	for (const auto& key : publickeys) {
+		this->whitelist_publickeys.erase(cut_pad_key_str(key));
+	}
+}
+
+
+void Efunguz::clear_whitelist_publickeys() {
+	lock_guard<mutex> io_lock(this->io_mutex);
+	this->whitelist_publickeys.clear();
+}
+
+
+void Efunguz::read_whitelist_publickeys(const string& filepath) {
+	unordered_set<string> keys{};
+	ifstream ifs(filepath, ios_base::in);
+	char line_cstr_buf[MAX_PUBLICKEYS_FILE_LINE_LEN];
+	while (ifs.getline(line_cstr_buf, MAX_PUBLICKEYS_FILE_LINE_LEN)) {
+		string line(line_cstr_buf);
+		if (line.size() >= KEY_Z85_LEN) {
+			keys.insert(line.substr(0, KEY_Z85_LEN));
+		}
+	}
+	this->add_whitelist_publickeys(keys);
+}
+
+
+tuple<Ehypha&, EW> Efunguz::add_ehypha_at(const string& serverkey, const string& endpoint, const string& socks_proxy) {
+	lock_guard<mutex> io_lock(this->io_mutex);
+	if (this->ehyphae.count(serverkey) == 0) {
+		// insert() would destroy temporary Ehypha, whose destructor would close its subsock, making copied subsock ptr useless
+		// (see the pair constructor in stl_pair.h that uses piecewise_construct_t)
+		this->ehyphae.emplace(piecewise_construct,
+			tuple<string>{serverkey},
+			tuple<zcontext*, mutex*, string, string, string, string, string, bool>{this->context, &(this->io_mutex), this->secretkey, this->publickey, serverkey, endpoint, socks_proxy, this->ehyphae_monitoring}
+		);
+		Ehypha& ehypha = this->ehyphae.at(serverkey);
+		ehypha.set_snapshotting(this->io_thread.joinable());
+		ehypha.set_warm_snapshot(this->warm_snapshot);
+#ifdef __linux__
+		zmqe_epoll_add(this->epoll_fd, ehypha.subsock, &ehypha); // unordered_map never moves its elements
+		ehypha.update();
+		if (ehypha.monsock != nullptr) {
+			zmqe_epoll_add(this->epoll_fd, ehypha.monsock, ehypha_mon_tag(&ehypha));
+			ehypha.update_mon();
+		}
+#endif
+		return tuple<Ehypha&, EW>{ehypha, EW::Ok};
+	} else {
+		return tuple<Ehypha&, EW>{this->ehyphae.at(serverkey), EW::AlreadyPresent};
+	}
+}
+
+
+tuple<Ehypha&, EW> Efunguz::add_ehypha(const string& that_publickey, const string& onion, const uint16_t pubsub_port) {
+	return this->add_ehypha_at(cut_pad_key_str(that_publickey), "tcp://" + onion + ".onion:" + to_string(pubsub_port), this->torproxy_host + ":" + to_string(this->torproxy_port));
+}
+
+
+tuple<Ehypha*, EW> Efunguz::add_ehypha_direct(const string& that_publickey, const string& endpoint) {
+	if (is_curve_endpoint(endpoint)) {
+		auto res = this->add_ehypha_at(cut_pad_key_str(that_publickey), endpoint, "");
+		return tuple<Ehypha*, EW>{&(get<0>(res)), get<1>(res)};
+	} else {
+		return tuple<Ehypha*, EW>{nullptr, EW::Unsupported};
+	}
+}
+
+
+tuple<Ehypha*, EW> Efunguz::get_ehypha_ptr(const string& that_publickey) {
+	string serverkey = cut_pad_key_str(that_publickey);
+	if (this->ehyphae.count(serverkey) == 1) {
+		return tuple<Ehypha*, EW>{&(this->ehyphae.at(serverkey)), EW::Ok};
+	} else {
+		return tuple<Ehypha*, EW>{nullptr, EW::Absent};
+	}
+}
+
+
+EW Efunguz::del_ehypha(const string& that_publickey) {
+	string serverkey = cut_pad_key_str(that_publickey);
+	lock_guard<mutex> io_lock(this->io_mutex);
+	if (this->ehyphae.count(serverkey) == 1) {
+#ifdef __linux__
+		Ehypha& ehypha = this->ehyphae.at(serverkey);
+		zmqe_epoll_del(this->epoll_fd, ehypha.subsock); // before the tag becomes dangling
+		if (ehypha.monsock != nullptr) {
+			zmqe_epoll_del(this->epoll_fd, ehypha.monsock);
+		}
+#endif
+		this->ehyphae.erase(serverkey);
+		return EW::Ok;
+	} else {
+		return EW::AlreadyAbsent;
+	}
+}
+
+
+bool Efunguz::emit_etale_head(const string& title, const int64_t t_out, const bool more, const vector<uint8_t>& time_tail) {
+	// Both frames are usually short enough to be stored inside zmq_msg_t itself, i.e. on the stack
+	zmq_msg_t msg;
+
+	zmqe_msg_init_topic(&msg, title, false);
+	if (!zmqe_send_msg(this->emitsock, &msg, true)) {
+		return false;
+	}
+
+	// Topic is not cached, replay has its own
+	this->emit_cache_collecting = this->emit_caching;
+	this->emit_cache_pending->frames.clear();
+
+	zmq_msg_init_size(&msg, 8 + time_tail.size()); // without codecs and keyframe reference, when all parts are raw, as before 0.9.12
+	memcpy(zmq_msg_data(&msg), &t_out, 8);
+	if (!time_tail.empty()) {
+		memcpy((uint8_t*)zmq_msg_data(&msg) + 8, time_tail.data(), time_tail.size());
+	}
+	return this->emit_frame(&msg, more);
+}
+
+
+bool Efunguz::emit_frame(zmq_msg_t* msg, const bool more) {
+	if (this->emit_cache_collecting) {
+		this->emit_cache_pending->frames.emplace_back();
+		zmq_msg_copy(this->emit_cache_pending->frames.back().zmsg(), msg); // shares data of long frames, refcounted
+	}
+	return zmqe_send_msg(this->emitsock, msg, more);
+}
+
+
+bool Efunguz::emit_frame_copy(const void* data, const size_t size, const bool more) {
+	zmq_msg_t msg;
+	zmq_msg_init_size(&msg, size);
+	if (size > 0) {
+		memcpy(zmq_msg_data(&msg), data, size);
+	}
+	return this->emit_frame(&msg, more);
+}
+
+
+// Below, once some frame is not sent (pubsock drops silently unless in nodrop mode, relaysock_app may be full), the rest is not sent either.
+// Sending may fail only at the 1st frame, since high-water mark of ZeroMQ counts entire messages
+
+bool Efunguz::emit_etale_at(const string& title, const int64_t t_out, const vector<vector<uint8_t>>& parts) {
+	EmitPacking* packing = this->emit_packing_of(title);
+	if ((packing != nullptr) || (this->emit_chunk_len > 0)) {
+		return this->emit_etale_packed(title, t_out, part_ptrs(parts), packing);
+	}
+
+	bool sent = this->emit_etale_head(title, t_out, !parts.empty());
+
+	size_t bytes_num = 0;
+	for (size_t i = 0; sent && (i < parts.size()); i++) {
+		bytes_num += parts[i].size();
+		sent = this->emit_frame_copy(parts[i].data(), parts[i].size(), (i + 1) < parts.size());
+	}
+
+	this->cache_emit(title, t_out, sent, false, false);
+	this->count_emit(title, bytes_num, bytes_num, sent);
+	return sent;
+}
+
+
+bool Efunguz::emit_etale_at(const string& title, const int64_t t_out, const vector<shared_part>& parts) {
+	EmitPacking* packing = this->emit_packing_of(title);
+	if ((packing != nullptr) || (this->emit_chunk_len > 0)) {
+		return this->emit_etale_packed(title, t_out, part_ptrs(parts), packing);
+	}
+
+	bool sent = this->emit_etale_head(title, t_out, !parts.empty());
+
+	size_t bytes_num = 0;
+	zmq_msg_t msg;
+	for (size_t i = 0; sent && (i < parts.size()); i++) {
+		bool more = (i + 1) < parts.size();
+		const vector<uint8_t>& part = *parts[i];
+		bytes_num += part.size();
+		if (part.size() < MIN_ZEROCOPY_PART_LEN) {
+			sent = this->emit_frame_copy(part.data(), part.size(), more);
+		} else {
+			zmq_msg_init_data(&msg, (void*)part.data(), part.size(), zmqe_free_shared_part, new shared_part(parts[i]));
+			sent = this->emit_frame(&msg, more);
+		}
+	}
+
+	this->cache_emit(title, t_out, sent, false, false);
+	this->count_emit(title, bytes_num, bytes_num, sent);
+	return sent;
+}
+
+
+// Parts that compression does not shorten, or too short for it, are copied as raw
+bool Efunguz::emit_etale_packed(const string& title, const int64_t t_out, const vector<const vector<uint8_t>*>& parts, EmitPacking* packing_of_title) {
+	EmitPacking raw;
+	EmitPacking& packing = (packing_of_title != nullptr) ? *packing_of_title : raw; // if etale is only chunked
+	const bool delta_encoded = packing.keyframe_interval > 0;
+	const bool keyframe = delta_encoded && (!packing.keyframe_emitted || (packing.deltas_num + 1 >= packing.keyframe_interval) || (parts.size() != packing.keyframe_parts.size()));
+	const uint32_t keyframe_num = keyframe ? ((packing.keyframe_num + 1) & ~KEYFRAME_BIT) : packing.keyframe_num;
+
+	vector<uint8_t> time_tail(parts.size(), uint8_t(Ecodec::Raw)); // codecs, then keyframe reference, if delta-encoded
+	vector<shared_ptr<vector<uint8_t>>> packed_parts(parts.size());
+	packing.spare_parts.resize(2 * parts.size());
+	bool packed_any = false;
+	for (size_t i = 0; i < parts.size(); i++) {
+		const vector<uint8_t>& part = *parts[i];
+		if (part.size() < packing.min_part_len) {
+			continue;
+		}
+		// Same-size etales, as usual, reuse buffers of previous one once it has been sent
+		shared_ptr<vector<uint8_t>> packed_part;
+		size_t packed_len = 0;
+		if (delta_encoded && !keyframe && (part.size() == packing.keyframe_parts[i].size())) {
+			vector<uint8_t>& xored = packing.xored;
+			xored.resize(part.size());
+			const vector<uint8_t>& base = packing.keyframe_parts[i];
+			for (size_t j = 0; j < part.size(); j++) {
+				xored[j] = part[j] ^ base[j];
+			}
+			packed_part = reuse_spare(packing.spare_parts[2 * i], part.size());
+			packed_len = rle_pack(xored.data(), xored.size(), packed_part->data());
+			if (packed_len > 0) {
+				time_tail[i] = uint8_t(Ecodec::XorRle);
+			}
+		}
+		if (packing.codec == Ecodec::Rle) {
+			// Delta may be longer than part itself compressed, e.g. when much has changed since keyframe
+			shared_ptr<vector<uint8_t>> rle_part = reuse_spare(packing.spare_parts[2 * i + 1], part.size());
+			size_t rle_len = rle_pack(part.data(), part.size(), rle_part->data());
+			if ((rle_len > 0) && ((packed_len == 0) || (rle_len < packed_len))) {
+				packed_part = move(rle_part);
+				packed_len = rle_len;
+				time_tail[i] = uint8_t(Ecodec::Rle);
+			}
+		}
+		if (packed_len > 0) {
+			packed_part->resize(packed_len); // keeps capacity
+			packed_parts[i] = move(packed_part);
+			packed_any = true;
+		}
+	}
+	if (delta_encoded) {
+		uint32_t keyframe_ref = keyframe_num | (keyframe ? KEYFRAME_BIT : 0);
+		time_tail.resize(parts.size() + KEYFRAME_REF_LEN);
+		memcpy(time_tail.data() + parts.size(), &keyframe_ref, KEYFRAME_REF_LEN);
+	} else if (!packed_any) {
+		time_tail.clear();
+	}
+
+	size_t bytes_num = 0;
+	size_t packed_bytes_num = 0;
+	vector<const vector<uint8_t>*> emitted_parts(parts.size());
+	for (size_t i = 0; i < parts.size(); i++) {
+		emitted_parts[i] = packed_parts[i] ? packed_parts[i].get() : parts[i];
+		bytes_num += parts[i]->size();
+		packed_bytes_num += emitted_parts[i]->size();
+	}
+
+	bool sent = false;
+	if ((this->emit_chunk_len > 0) && ((packed_bytes_num > this->emit_chunk_len) || this->emit_chunks_pending(title))) {
+		sent = this->emit_etale_chunked(title, t_out, time_tail, emitted_parts, packing.spare_serialized);
+	} else {
+		sent = this->emit_etale_head(title, t_out, !parts.empty(), time_tail);
+		zmq_msg_t msg;
+		for (size_t i = 0; sent && (i < parts.size()); i++) {
+			bool more = (i + 1) < parts.size();
+			const vector<uint8_t>& part = *emitted_parts[i];
+			if (!packed_parts[i] || (part.size() < MIN_ZEROCOPY_PART_LEN)) {
+				sent = this->emit_frame_copy(part.data(), part.size(), more);
+			} else {
+				zmq_msg_init_data(&msg, (void*)part.data(), part.size(), zmqe_free_shared_part, new shared_part(packed_parts[i]));
+				sent = this->emit_frame(&msg, more);
+			}
+		}
+	}
+
+	// Unsent keyframe is not base of deltas, so the previous one stays
+	if (sent && keyframe) {
+		packing.keyframe_parts.resize(parts.size());
+		for (size_t i = 0; i < parts.size(); i++) {
+			packing.keyframe_parts[i] = *parts[i];
+		}
+		packing.keyframe_num = keyframe_num;
+		packing.keyframe_emitted = true;
+		packing.deltas_num = 0;
+	} else if (sent && delta_encoded) {
+		packing.deltas_num++;
+	}
+
+	this->cache_emit(title, t_out, sent, keyframe, delta_encoded);
+	this->count_emit(title, bytes_num, packed_bytes_num, sent);
+	return sent;
+}
+
+
+bool Efunguz::emit_etale_chunked(const string& title, const int64_t t_out, const vector<uint8_t>& time_tail, const vector<const vector<uint8_t>*>& parts, shared_ptr<vector<uint8_t>>& spare) {
+	vector<pair<const uint8_t*, size_t>> spans;
+	for (const auto* part : parts) {
+		spans.emplace_back(part->data(), part->size());
+	}
+	shared_part etale = serialize_etale(time_tail.data(), time_tail.size(), spans, spare);
+	if (this->emit_caching) {
+		this->emit_cache_pending->serialized = etale;
+		this->emit_cache_pending->chunk_len = this->emit_chunk_len;
+	}
+	return this->queue_chunks(title, t_out, etale, this->emit_chunk_len, false);
+}
+
+
+bool Efunguz::queue_chunks(const string& title, const int64_t t_out, const shared_part& etale, const size_t chunk_len, const bool replay) {
+	{
+		lock_guard<mutex> chunks_lock(this->emit_chunks_mutex);
+		shared_ptr<EmitChunks> chunks;
+		for (const auto& pending : this->emit_chunks_queue) {
+			if (pending->title == title) {
+				chunks = pending;
+				break;
+			}
+		}
+		if (!chunks) {
+			chunks = make_shared<EmitChunks>();
+			chunks->title = title;
+			chunks->next_index = 0;
+			this->emit_chunks_queue.push_back(chunks);
+		} else if (!replay && (chunks->etales.size() >= MAX_CHUNKED_ETALES_NUM)) {
+			return false;
+		} else if (replay) {
+			// Replays are not limited, but the same etale whose chunks have not been sent yet will reach new subscriber anyway
+			for (size_t i = 0; i < chunks->etales.size(); i++) {
+				if ((get<1>(chunks->etales[i]) == etale) && ((i > 0) || (chunks->next_index == 0))) {
+					return true;
+				}
+			}
+		}
+		chunks->etales.emplace_back(t_out, etale, chunk_len, replay);
+	}
+
+	if (!replay && (this->emitsock != this->pubsock)) {
+		zmqe_send_copy(this->emitsock, nullptr, 0, false); // to wake I/O thread up, which sends chunks; replays are queued by I/O thread itself
+	}
+	return true;
+}
+
+
+bool Efunguz::emit_chunks_pending(const string& title) {
+	lock_guard<mutex> chunks_lock(this->emit_chunks_mutex);
+	for (const auto& pending : this->emit_chunks_queue) {
+		if (pending->title == title) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool Efunguz::emit_etale(const string& title, const vector<vector<uint8_t>>& parts) {
+	return this->emit_etale_at(title, time_musec(), parts);
+}
+
+
+bool Efunguz::emit_etale(const string& title, vector<vector<uint8_t>>&& parts) {
+	EmitPacking* packing = this->emit_packing_of(title);
+	if ((packing != nullptr) || (this->emit_chunk_len > 0)) {
+		bool sent = this->emit_etale_packed(title, time_musec(), part_ptrs(parts), packing);
+		parts.clear();
+		return sent;
+	}
+
+	int64_t t_out = time_musec();
+	bool sent = this->emit_etale_head(title, t_out, !parts.empty());
+
+	size_t bytes_num = 0;
+	zmq_msg_t msg;
+	for (size_t i = 0; sent && (i < parts.size()); i++) {
+		bool more = (i + 1) < parts.size();
+		bytes_num += parts[i].size();
+		if (parts[i].size() < MIN_ZEROCOPY_PART_LEN) {
+			sent = this->emit_frame_copy(parts[i].data(), parts[i].size(), more);
+		} else {
+			vector<uint8_t>* part = new vector<uint8_t>(move(parts[i]));
+			zmq_msg_init_data(&msg, part->data(), part->size(), zmqe_free_vec_u8, part);
+			sent = this->emit_frame(&msg, more);
+		}
+	}
+	parts.clear();
+
+	this->cache_emit(title, t_out, sent, false, false);
+	this->count_emit(title, bytes_num, bytes_num, sent);
+	return sent;
+}
+
+
+bool Efunguz::emit_etale(const string& title, const vector<shared_part>& parts) {
+	return this->emit_etale_at(title, time_musec(), parts);
+}
+
+
+vector<bool> Efunguz::emit_etales(const vector<tuple<string, vector<vector<uint8_t>>>>& batch) {
+	int64_t t_out = time_musec();
+	vector<bool> sent(batch.size(), false);
+	for (size_t i = 0; i < batch.size(); i++) {
+		sent[i] = this->emit_etale_at(get<0>(batch[i]), t_out, get<1>(batch[i]));
+	}
+	return sent;
+}
+
+
+vector<bool> Efunguz::emit_etales(const vector<tuple<string, vector<shared_part>>>& batch) {
+	int64_t t_out = time_musec();
+	vector<bool> sent(batch.size(), false);
+	for (size_t i = 0; i < batch.size(); i++) {
+		sent[i] = this->emit_etale_at(get<0>(batch[i]), t_out, get<1>(batch[i]));
+	}
+	return sent;
+}
+
+
+void Efunguz::set_emit_hwm(const int hwm) {
+	lock_guard<mutex> io_lock(this->io_mutex);
+	zmqe_setsockopt(this->pubsock, ZMQ_SNDHWM, hwm);
+}
+
+
+void Efunguz::set_emit_nodrop(const bool nodrop) {
+	lock_guard<mutex> io_lock(this->io_mutex);
+	zmqe_setsockopt(this->pubsock, ZMQ_XPUB_NODROP, nodrop ? 1 : 0);
+}
+
+
+void Efunguz::set_emit_compression(const string& title, const Ecodec codec, const size_t min_part_len) {
+	EmitPacking& packing = this->emit_packing_at(title);
+	packing.codec = (codec == Ecodec::Rle) ? Ecodec::Rle : Ecodec::Raw; // XorRle is only for deltas
+	packing.min_part_len = min_part_len;
+	if ((packing.codec == Ecodec::Raw) && (packing.keyframe_interval == 0)) {
+		this->emit_packings.erase(title);
+	}
+}
+
+
+void Efunguz::set_emit_delta(const string& title, const size_t keyframe_interval) {
+	EmitPacking& packing = this->emit_packing_at(title);
+	packing.keyframe_interval = keyframe_interval;
+	packing.keyframe_emitted = false; // so that next etale is keyframe
+	packing.keyframe_parts.clear();
+	if ((packing.codec == Ecodec::Raw) && (packing.keyframe_interval == 0)) {
+		this->emit_packings.erase(title);
+	}
+}
+
+
+void Efunguz::set_emit_chunking(const size_t chunk_len, const size_t max_rate) {
+	this->emit_chunk_len = chunk_len;
+	lock_guard<mutex> chunks_lock(this->emit_chunks_mutex);
+	this->emit_chunks_rate = max_rate;
+	this->emit_chunks_tokens = 0;
+	this->t_emit_chunks_refill = time_musec();
+}
+
+
+EmitPacking* Efunguz::emit_packing_of(const string& title) {
+	if (this->emit_packings.empty()) { // usual case, without lookup
+		return nullptr;
+	}
+	auto it = this->emit_packings.find(title);
+	return (it != this->emit_packings.end()) ? it->second.get() : nullptr;
+}
+
+
+EmitPacking& Efunguz::emit_packing_at(const string& title) {
+	auto& packing = this->emit_packings[title];
+	if (!packing) {
+		packing = make_shared<EmitPacking>();
+	}
+	return *packing;
+}
+
+
+void Efunguz::cache_emit(const string& title, const int64_t t_out, const bool sent, const bool keyframe, const bool delta) {
+	this->emit_cache_collecting = false;
+	if (!this->emit_caching) {
+		return;
+	}
+	CachedEtale& pending = *this->emit_cache_pending;
+	if (sent) {
+		pending.t_out = t_out;
+		lock_guard<mutex> cache_lock(this->emit_cache_mutex);
+		shared_ptr<EmitCache>& cache = this->emit_cache[title];
+		if (!cache) {
+			cache = make_shared<EmitCache>();
+		}
+		if (keyframe) {
+			cache->keyframe = pending; // frames are shared, see Epart
+		} else if (!delta) {
+			cache->keyframe = CachedEtale();
+		}
+		cache->latest = move(pending);
+	}
+	pending = CachedEtale();
+}
+
+
+void Efunguz::count_emit(const string& title, const size_t bytes_num, const size_t packed_bytes_num, const bool sent) {
+	// Only this (emitting) thread inserts, so it may look up without lock
+	auto it = this->emit_counters.find(title);
+	if (it == this->emit_counters.end()) {
+		lock_guard<mutex> counters_lock(this->emit_counters_mutex);
+		it = this->emit_counters.emplace(title, make_shared<EmitCounters>()).first;
+	}
+	EmitCounters& counters = *(it->second);
+	if (sent) {
+		add_relaxed(counters.msgs_num, 1);
+		add_relaxed(counters.bytes_num, bytes_num);
+		add_relaxed(counters.packed_bytes_num, packed_bytes_num);
+	} else {
+		add_relaxed(counters.failed_num, 1);
+	}
+}
+
+
+void Efunguz::set_emit_cache(const bool caching) {
+	this->emit_caching = caching;
+	if (!caching) {
+		lock_guard<mutex> cache_lock(this->emit_cache_mutex);
+		this->emit_cache.clear();
+	}
+}
+
+
+unordered_map<string, EmitStats> Efunguz::emit_stats() {
+	unordered_map<string, EmitStats> stats;
+	lock_guard<mutex> counters_lock(this->emit_counters_mutex);
+	for (const auto& keyval : this->emit_counters) {
+		stats.emplace(keyval.first, keyval.second->load());
+	}
+	return stats;
+}
+
+
+bool Efunguz::save_snapshot(const string& filepath) {
+	// Parts are shared, not copied, so lock is held only while collecting them
+	vector<tuple<string, string, int64_t, int64_t, vector<Epart>>> records; // key, title of latest message, t_out, t_in, parts
+	{
+		lock_guard<mutex> io_lock(this->io_mutex);
+		for (auto& ehypha_kv : this->ehyphae) {
+			const string& serverkey = ehypha_kv.first;
+			auto add_record = [&records, &serverkey](const char kind, const string& title, const Etale& etale) {
+				if (etale.t_in >= 0) {
+					records.emplace_back(serverkey + kind + title, etale.msg_title, etale.t_out, etale.t_in, etale.zparts);
+				}
+			};
+			ehypha_kv.second.etales.for_each([&add_record](const string& title, Etale& etale) { add_record(SNAPSHOT_KIND_TITLE, title, etale); });
+			ehypha_kv.second.prefix_etales.for_each([&add_record](const string& prefix, Etale& etale) { add_record(SNAPSHOT_KIND_PREFIX, prefix, etale); });
+		}
+	}
+	sort(records.begin(), records.end(), [](const tuple<string, string, int64_t, int64_t, vector<Epart>>& a, const tuple<string, string, int64_t, int64_t, vector<Epart>>& b) {
+		return get<0>(a) < get<0>(b); // byte-wise, as memcmp() in WarmSnapshot::find()
+	});
+
+	string tmp_filepath = filepath + ".tmp";
+	ofstream ofs(tmp_filepath, ios_base::out | ios_base::binary | ios_base::trunc);
+	const char zeros[8] = {0};
+	uint64_t offset = SNAPSHOT_HEADER_LEN + 8 * records.size();
+	uint32_t records_num = uint32_t(records.size());
+	ofs.write(SNAPSHOT_MAGIC, 8);
+	ofs.write((const char*)&SNAPSHOT_VERSION, 4);
+	ofs.write((const char*)&records_num, 4);
+	for (const auto& record : records) {
+		ofs.write((const char*)&offset, 8);
+		offset += (SNAPSHOT_RECORD_HEADER_LEN + get<0>(record).size() + get<1>(record).size() + 7) & ~size_t(7);
+		offset += 8 * get<4>(record).size();
+		for (const auto& part : get<4>(record)) {
+			offset += (part.size() + 7) & ~size_t(7);
+		}
+	}
+	for (const auto& record : records) {
+		uint32_t key_len = uint32_t(get<0>(record).size());
+		uint32_t msg_title_len = uint32_t(get<1>(record).size());
+		uint32_t parts_num = uint32_t(get<4>(record).size());
+		ofs.write((const char*)&get<2>(record), 8);
+		ofs.write((const char*)&get<3>(record), 8);
+		ofs.write((const char*)&key_len, 4);
+		ofs.write((const char*)&msg_title_len, 4);
+		ofs.write((const char*)&parts_num, 4);
+		ofs.write(zeros, 4);
+		ofs.write(get<0>(record).data(), key_len);
+		ofs.write(get<1>(record).data(), msg_title_len);
+		ofs.write(zeros, (8 - (key_len + msg_title_len) % 8) % 8);
+		for (const auto& part : get<4>(record)) {
+			uint64_t part_len = part.size();
+			ofs.write((const char*)&part_len, 8);
+		}
+		for (const auto& part : get<4>(record)) {
+			ofs.write((const char*)part.data(), part.size());
+			ofs.write(zeros, (8 - part.size() % 8) % 8);
+		}
+	}
+	ofs.close();
+	if (!ofs) {
+		remove(tmp_filepath.c_str());
+		return false;
+	}
+	// Readers that have mapped previous file keep it, renaming does not change it
+	return rename(tmp_filepath.c_str(), filepath.c_str()) == 0;
+}
+
+
+bool Efunguz::load_snapshot(const string& filepath) {
+	int fd = open(filepath.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if ((fstat(fd, &st) != 0) || (size_t(st.st_size) < SNAPSHOT_HEADER_LEN)) {
+		close(fd);
+		return false;
+	}
+	size_t len = size_t(st.st_size);
+	void* data = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // mapping stays
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint32_t version = 0;
+	uint32_t records_num = 0;
+	memcpy(&version, bytes + 8, 4);
+	memcpy(&records_num, bytes + 12, 4);
+	if ((memcmp(bytes, SNAPSHOT_MAGIC, 8) != 0) || (version != SNAPSHOT_VERSION) || (records_num > (len - SNAPSHOT_HEADER_LEN) / 8)) {
+		munmap(data, len);
+		return false;
+	}
+
+	lock_guard<mutex> io_lock(this->io_mutex);
+	this->warm_snapshot = make_shared<WarmSnapshot>(bytes, len);
+	for (auto& ehypha_kv : this->ehyphae) {
+		ehypha_kv.second.set_warm_snapshot(this->warm_snapshot);
+	}
+	return true;
+}
+
+
+void Efunguz::update_zap() {
+	while ((zmqe_getsockopt_events(this->zapsock) & ZMQ_POLLIN) != 0) {
+		vector<vector<uint8_t>> request = zmqe_recv(this->zapsock);
+		vector<vector<uint8_t>> reply;
+
+		auto& version = request[0];
+		auto& sequence = request[1];
+		// auto& domain = request[2];
+		// auto& address = request[3];
+		auto& identity = request[4];
+		auto& mechanism = request[5];
+		auto& key_u8 = request[6];
+
+		char key_cstr[KEY_Z85_CSTR_LEN]{0};
+		zmq_z85_encode(key_cstr, key_u8.data(), KEY_BIN_LEN);
+		string key(key_cstr);
+
+		reply.push_back(version);
+		reply.push_back(sequence);
 
 		if ((identity == this->zap_session_id) && (mechanism == cstr_to_vec_u8(CURVE_MECHANISM_ID)) && (this->whitelist_publickeys.empty() || (this->whitelist_publickeys.count(key) == 1))) {
 			// Auth passed; though needless (yet), set user-id to client's publickey
@@ -420,44 +2545,515 @@ void Efunguz::update() {
 			reply.push_back(cstr_to_vec_u8("OK"));
 			reply.push_back(cstr_to_vec_u8(key_cstr));
 			reply.push_back(cstr_to_vec_u8(""));
+			this->zap_verdicts.emplace_back(key, true);
 		} else {
 			// Auth failed
 			reply.push_back(cstr_to_vec_u8("400"));
 			reply.push_back(cstr_to_vec_u8("FAILED"));
 			reply.push_back(cstr_to_vec_u8(""));
 			reply.push_back(cstr_to_vec_u8(""));
+			this->zap_verdicts.emplace_back(key, false);
+		}
+		if (this->zap_verdicts.size() > MAX_ZAP_VERDICTS_NUM) {
+			this->zap_verdicts.pop_front();
 		}
 
 		zmqe_send(this->zapsock, reply);
 	}
+}
 
-	for (auto& keyval : this->ehyphae) {
-		keyval.second.update();
-	}
 
-	while (zmqe_getsockopt_events(this->monsock) & ZMQ_POLLIN != 0) {
+void Efunguz::update_mon() {
+	while ((zmqe_getsockopt_events(this->monsock) & ZMQ_POLLIN) != 0) {
 		vector<vector<uint8_t>> event_msg = zmqe_recv(this->monsock);
 		if (event_msg.size() > 0) {
-			if (event_msg[0].size() >= 2) {
+			if (event_msg[0].size() >= 6) {
 				uint16_t event_num = *((uint16_t *)(event_msg[0].data()));
-				if (event_num & ZMQ_EVENT_ACCEPTED) {
-					this->in_accepted_num++;	
+				uint32_t event_value = 0; // fd, error code etc., depending on event
+				memcpy(&event_value, event_msg[0].data() + 2, 4);
+				this->update_mon_event(event_num, event_value);
+			}
+		}
+	}
+}
+
+
+void Efunguz::update_mon_event(const uint16_t event_num, const uint32_t event_value) {
+	int64_t t = time_musec();
+	lock_guard<mutex> connections_lock(this->in_connections_mutex);
+
+	// Earliest connection still in handshake, to which handshake event (that has no fd) is ascribed
+	InConnection* pending = nullptr;
+	for (auto& connection : this->in_connections_open) {
+		if ((connection.t_handshaken < 0) && (connection.handshake_failure == 0)) {
+			pending = &connection;
+			break;
+		}
+	}
+	// Same for ZAP verdicts
+	auto claim_verdict = [this](const bool approved) {
+		for (auto it = this->zap_verdicts.begin(); it != this->zap_verdicts.end(); it++) {
+			if (get<1>(*it) == approved) {
+				string publickey = get<0>(*it);
+				this->zap_verdicts.erase(it);
+				return publickey;
+			}
+		}
+		return string("");
+	};
+
+	if (event_num & ZMQ_EVENT_ACCEPTED) {
+		this->in_accepted_num++;
+		int fd = (int)event_value;
+		this->in_connections_open.push_back(InConnection{fd, fd_peer_address(fd), "", t, -1, 0, -1});
+	}
+	if (event_num & ZMQ_EVENT_HANDSHAKE_SUCCEEDED) {
+		this->in_handshake_succeeded_num++;
+		string publickey = claim_verdict(true);
+		if (pending != nullptr) {
+			pending->publickey = publickey;
+			pending->t_handshaken = t;
+		}
+	}
+	if (event_num & (ZMQ_EVENT_HANDSHAKE_FAILED_NO_DETAIL | ZMQ_EVENT_HANDSHAKE_FAILED_PROTOCOL | ZMQ_EVENT_HANDSHAKE_FAILED_AUTH)) {
+		this->in_handshake_failed_num++;
+		string publickey = (event_num & ZMQ_EVENT_HANDSHAKE_FAILED_AUTH) ? claim_verdict(false) : string("");
+		if (pending != nullptr) {
+			pending->publickey = publickey; // rejected one
+			pending->handshake_failure = event_num;
+		}
+	}
+	if (event_num & ZMQ_EVENT_DISCONNECTED) {
+		this->in_disconnected_num++;
+		for (auto it = this->in_connections_open.begin(); it != this->in_connections_open.end(); it++) {
+			if (it->fd == (int)event_value) {
+				it->t_closed = t;
+				this->in_connections_closed.push_back(move(*it));
+				this->in_connections_open.erase(it);
+				if (this->in_connections_closed.size() > IN_CLOSED_CONNECTIONS_MAX_NUM) {
+					this->in_connections_closed.pop_front();
+				}
+				break;
+			}
+		}
+	}
+}
+
+
+void Efunguz::update_relay() {
+	zmq_msg_t msg;
+	while ((zmqe_getsockopt_events(this->relaysock_io) & ZMQ_POLLIN) != 0) {
+		zmq_msg_init(&msg);
+		zmq_msg_recv(&msg, this->relaysock_io, 0);
+		if (zmq_msg_more(&msg)) {
+			// Frames are moved, not copied; in nodrop mode, 1st one may be refused, then the rest is dropped too
+			bool more = true;
+			bool sent = true;
+			while (more) {
+				if (sent) {
+					sent = zmqe_send_msg(this->pubsock, &msg, true);
+				} else {
+					zmq_msg_close(&msg);
+				}
+				zmq_msg_init(&msg);
+				zmq_msg_recv(&msg, this->relaysock_io, 0);
+				more = zmq_msg_more(&msg);
+			}
+			if (sent) {
+				zmqe_send_msg(this->pubsock, &msg, false);
+			} else {
+				zmq_msg_close(&msg);
+			}
+		} else {
+			zmq_msg_close(&msg); // single frame is wake-up from stop_io_thread() or emit_etale_chunked(), not etale
+		}
+	}
+}
+
+
+uint64_t Efunguz::subscriptions_num(const string& title) {
+	lock_guard<mutex> subscriptions_lock(this->subscriptions_mutex);
+	auto it = this->title_subscriptions.find(title);
+	uint64_t num = (it != this->title_subscriptions.end()) ? it->second : 0;
+	for (const auto& prefix_num : this->prefix_subscriptions) {
+		if (topic_matches(title, prefix_num.first.data(), prefix_num.first.size())) {
+			num += prefix_num.second;
+		}
+	}
+	return num;
+}
+
+
+// Subscription is 1 byte (1 to subscribe, 0 to unsubscribe) and prefix of topics
+void Efunguz::update_subscriptions() {
+	Epart sub;
+	while ((zmqe_getsockopt_events(this->pubsock) & ZMQ_POLLIN) != 0) {
+		zmq_msg_recv(sub.zmsg(), this->pubsock, 0);
+		if ((sub.size() < 1) || (sub.data()[0] > 1)) {
+			continue;
+		}
+		const bool subscribed = sub.data()[0] == 1;
+		const char* prefix = (const char*)sub.data() + 1;
+		const size_t prefix_len = sub.size() - 1;
+		// Entire title with terminating zero byte, as subscribed by Ehypha::add_etale()
+		const bool title = (prefix_len > 0) && (prefix[prefix_len - 1] == 0) && (memchr(prefix, 0, prefix_len - 1) == nullptr);
+
+		{
+			lock_guard<mutex> subscriptions_lock(this->subscriptions_mutex);
+			auto& subscriptions = title ? this->title_subscriptions : this->prefix_subscriptions;
+			string key(prefix, title ? (prefix_len - 1) : prefix_len);
+			if (subscribed) {
+				subscriptions[key]++;
+			} else {
+				auto it = subscriptions.find(key);
+				if ((it != subscriptions.end()) && (--(it->second) == 0)) {
+					subscriptions.erase(it);
 				}
-				if (event_num & ZMQ_EVENT_HANDSHAKE_SUCCEEDED) {
-					this->in_handshake_succeeded_num++;
+			}
+		}
+
+		if (!subscribed) {
+			continue;
+		}
+		lock_guard<mutex> cache_lock(this->emit_cache_mutex);
+		if (this->emit_cache.empty()) {
+			continue;
+		}
+		if (title) {
+			auto it = this->emit_cache.find(string(prefix, prefix_len - 1));
+			if (it != this->emit_cache.end()) {
+				this->replay_cached(it->first, *(it->second));
+			}
+		} else {
+			for (const auto& title_cache : this->emit_cache) {
+				if (topic_matches(title_cache.first, prefix, prefix_len)) {
+					this->replay_cached(title_cache.first, *(title_cache.second));
 				}
-				if (event_num & ZMQ_EVENT_DISCONNECTED) {
-					this->in_disconnected_num++;
+			}
+		}
+	}
+}
+
+
+// To all subscribers of title, who ignore what they already have; in nodrop mode, what does not fit is not replayed at all
+void Efunguz::replay_cached(const string& title, const EmitCache& cache) {
+	vector<const CachedEtale*> etales;
+	if ((cache.keyframe.t_out >= 0) && (cache.keyframe.t_out != cache.latest.t_out)) {
+		etales.push_back(&cache.keyframe);
+	}
+	if (cache.latest.t_out >= 0) {
+		etales.push_back(&cache.latest);
+	}
+	// Keyframe must go before latest etale, and both after pending chunks of title
+	bool chunked = this->emit_chunks_pending(title);
+	for (const CachedEtale* etale : etales) {
+		chunked = chunked || etale->serialized;
+	}
+
+	zmq_msg_t msg;
+	for (const CachedEtale* etale : etales) {
+		if (chunked) {
+			shared_part serialized = etale->serialized;
+			size_t chunk_len = etale->chunk_len;
+			if (!serialized) {
+				const Epart& time = etale->frames[0];
+				vector<pair<const uint8_t*, size_t>> spans;
+				for (size_t i = 1; i < etale->frames.size(); i++) {
+					spans.emplace_back(etale->frames[i].data(), etale->frames[i].size());
 				}
+				shared_ptr<vector<uint8_t>> spare; // replays are rare
+				serialized = serialize_etale(time.data() + 8, time.size() - 8, spans, spare);
+				chunk_len = serialized->size(); // single chunk
+			}
+			this->queue_chunks(title, etale->t_out, serialized, max(chunk_len, size_t(1)), true);
+		} else {
+			zmqe_msg_init_topic(&msg, title, true);
+			bool sent = zmqe_send_msg(this->pubsock, &msg, true);
+			for (size_t i = 0; sent && (i < etale->frames.size()); i++) {
+				zmq_msg_init(&msg);
+				zmq_msg_copy(&msg, const_cast<zmq_msg_t*>(&(etale->frames[i].msg)));
+				sent = zmqe_send_msg(this->pubsock, &msg, (i + 1) < etale->frames.size());
+			}
+		}
+	}
+}
+
+
+void Efunguz::update() {
+	if (!this->io_thread.joinable()) {
+		this->update_ready(0);
+	}
+}
+
+
+void Efunguz::wait_update(const long timeout_ms) {
+	if (!this->io_thread.joinable()) {
+		this->update_ready(this->chunks_timeout_ms(timeout_ms));
+	}
+}
+
+
+void Efunguz::update_chunks() {
+	lock_guard<mutex> chunks_lock(this->emit_chunks_mutex);
+	if (this->emit_chunks_queue.empty()) {
+		return;
+	}
+	if (this->emit_chunks_rate > 0) {
+		int64_t t = time_musec();
+		this->emit_chunks_tokens = min(this->emit_chunks_tokens + 1e-6 * this->emit_chunks_rate * (t - this->t_emit_chunks_refill), 1e-6 * this->emit_chunks_rate * CHUNKS_BURST_MUSEC);
+		this->t_emit_chunks_refill = t;
+	}
+
+	zmq_msg_t msg;
+	size_t sent_len = 0;
+	this->emit_chunks_refused = false;
+	while (!this->emit_chunks_queue.empty() && ((this->emit_chunks_rate > 0) ? (this->emit_chunks_tokens > 0) : (sent_len < MAX_CHUNKS_BYTES_PER_UPDATE))) {
+		shared_ptr<EmitChunks> chunks = this->emit_chunks_queue.front();
+		const auto& etale = chunks->etales.front();
+		const shared_part& data = get<1>(etale);
+		const size_t chunk_len = get<2>(etale);
+		const uint32_t chunks_num = uint32_t((data->size() + chunk_len - 1) / chunk_len);
+		const size_t offset = size_t(chunks->next_index) * chunk_len;
+		const size_t len = min(chunk_len, data->size() - offset);
+
+		uint8_t time[8 + CHUNK_HEADER_LEN];
+		int64_t t_out = get<0>(etale);
+		memcpy(time, &t_out, 8);
+		memcpy(time + 8, &(chunks->next_index), 4);
+		memcpy(time + 12, &chunks_num, 4);
+		zmqe_msg_init_topic(&msg, chunks->title, get<3>(etale));
+		if (!zmqe_send_msg(this->pubsock, &msg, true)) {
+			this->emit_chunks_refused = true; // in nodrop mode, so retried later
+			break;
+		}
+		zmqe_send_copy(this->pubsock, time, sizeof(time), true);
+		if (len < MIN_ZEROCOPY_PART_LEN) {
+			zmqe_send_copy(this->pubsock, data->data() + offset, len, false);
+		} else {
+			zmq_msg_init_data(&msg, (void*)(data->data() + offset), len, zmqe_free_shared_part, new shared_part(data));
+			zmqe_send_msg(this->pubsock, &msg, false);
+		}
+		this->emit_chunks_tokens -= len;
+		sent_len += len;
+
+		this->emit_chunks_queue.pop_front();
+		chunks->next_index++;
+		if (chunks->next_index == chunks_num) {
+			chunks->etales.pop_front();
+			chunks->next_index = 0;
+		}
+		if (!chunks->etales.empty()) {
+			this->emit_chunks_queue.push_back(chunks); // next title goes first
+		}
+	}
+}
+
+
+// Timeout of waiting, shortened while chunks are due
+long Efunguz::chunks_timeout_ms(const long timeout_ms) {
+	lock_guard<mutex> chunks_lock(this->emit_chunks_mutex);
+	if (this->emit_chunks_queue.empty()) {
+		return timeout_ms;
+	}
+	long chunks_timeout = ((this->emit_chunks_rate > 0) || this->emit_chunks_refused) ? 1 : 0; // w/o rate limit, next ones are due at once, refused ones soon
+	if ((this->emit_chunks_rate > 0) && (this->emit_chunks_tokens <= 0)) {
+		chunks_timeout = max(1L, long(1e3 * (1.0 - this->emit_chunks_tokens) / this->emit_chunks_rate) + 1);
+	}
+	return (timeout_ms < 0) ? chunks_timeout : min(timeout_ms, chunks_timeout);
+}
+
+
+#ifdef __linux__
+
+void Efunguz::update_ready(const long timeout_ms) {
+	epoll_event events[MAX_EPOLL_EVENTS];
+	int timeout = (int)timeout_ms;
+	int events_num = 0;
+	do {
+		events_num = epoll_wait(this->epoll_fd, events, MAX_EPOLL_EVENTS, timeout);
+		bool zap_ready = false;
+		bool mon_ready = false;
+		bool relay_ready = false;
+		for (int i = 0; i < events_num; i++) {
+			void* tag = events[i].data.ptr;
+			if (tag == this->zapsock) {
+				zap_ready = true;
+			} else if (tag == this->monsock) {
+				mon_ready = true;
+			} else if (tag == this->relaysock_io) {
+				relay_ready = true;
+			} else if (tag == this->pubsock) {
+				// Subscriptions, read below anyway
+			} else if ((uintptr_t(tag) & 1) == 0) {
+				((Ehypha*)tag)->update();
+			} else {
+				((Ehypha*)(uintptr_t(tag) & ~uintptr_t(1)))->update_mon();
+			}
+		}
+		if (zap_ready) {
+			this->update_zap();
+		}
+		if (mon_ready) {
+			this->update_mon();
+		}
+		if (relay_ready) {
+			this->update_relay();
+		}
+		timeout = 0;
+	} while (events_num == MAX_EPOLL_EVENTS); // more may be ready
+
+	this->update_subscriptions(); // each time, since sending to pubsock may take its readiness without signalling its fd
+	this->update_chunks();
+}
+
+
+vector<int> Efunguz::get_fds() {
+	return vector<int>{this->epoll_fd}; // epoll instance is readable when any of its sockets is
+}
+
+#else
+
+void Efunguz::update_ready(const long timeout_ms) {
+	vector<zmq_pollitem_t> items{
+		zmq_pollitem_t{this->zapsock, 0, ZMQ_POLLIN, 0},
+		zmq_pollitem_t{this->monsock, 0, ZMQ_POLLIN, 0},
+		zmq_pollitem_t{this->relaysock_io, 0, (this->relaysock_io != nullptr) ? ZMQ_POLLIN : 0, 0},
+		zmq_pollitem_t{this->pubsock, 0, ZMQ_POLLIN, 0}
+	};
+	vector<Ehypha*> items_ehyphae{};
+	for (auto& keyval : this->ehyphae) {
+		items.push_back(zmq_pollitem_t{keyval.second.subsock, 0, ZMQ_POLLIN, 0});
+		items_ehyphae.push_back(&(keyval.second));
+	}
+	vector<Ehypha*> items_ehyphae_mon{};
+	for (auto& keyval : this->ehyphae) {
+		if (keyval.second.monsock != nullptr) {
+			items.push_back(zmq_pollitem_t{keyval.second.monsock, 0, ZMQ_POLLIN, 0});
+			items_ehyphae_mon.push_back(&(keyval.second));
+		}
+	}
+
+	if (zmq_poll(items.data(), (int)items.size(), timeout_ms) > 0) {
+		if (items[0].revents & ZMQ_POLLIN) {
+			this->update_zap();
+		}
+		for (size_t i = 0; i < items_ehyphae.size(); i++) {
+			if (items[4 + i].revents & ZMQ_POLLIN) {
+				items_ehyphae[i]->update();
+			}
+		}
+		for (size_t i = 0; i < items_ehyphae_mon.size(); i++) {
+			if (items[4 + items_ehyphae.size() + i].revents & ZMQ_POLLIN) {
+				items_ehyphae_mon[i]->update_mon();
+			}
+		}
+		if (items[1].revents & ZMQ_POLLIN) {
+			this->update_mon();
+		}
+		if (items[2].revents & ZMQ_POLLIN) {
+			this->update_relay();
+		}
+	}
+
+	this->update_subscriptions();
+	this->update_chunks();
+}
+
+
+vector<int> Efunguz::get_fds() {
+	vector<int> fds{zmqe_getsockopt_fd(this->zapsock), zmqe_getsockopt_fd(this->monsock), zmqe_getsockopt_fd(this->pubsock)};
+	if (this->relaysock_io != nullptr) {
+		fds.push_back(zmqe_getsockopt_fd(this->relaysock_io));
+	}
+	for (const auto& keyval : this->ehyphae) {
+		fds.push_back(zmqe_getsockopt_fd(keyval.second.subsock));
+		if (keyval.second.monsock != nullptr) {
+			fds.push_back(zmqe_getsockopt_fd(keyval.second.monsock));
+		}
+	}
+	return fds;
+}
+
+#endif
 
+
+void Efunguz::run_io(const long idle_timeout_ms) {
+	vector<int> fds{};
+	vector<pollfd> items{};
+	while (this->io_running) {
+		{
+			lock_guard<mutex> io_lock(this->io_mutex);
+#ifdef __linux__
+			if (fds.empty()) {
+				fds = this->get_fds(); // single epoll fd, which never changes
 			}
-			
+#else
+			fds = this->get_fds();
+#endif
+		}
+		wait_fds_readable(fds, this->chunks_timeout_ms(idle_timeout_ms), items); // without lock, so that application thread can add ehyphae etc. meanwhile
+		{
+			lock_guard<mutex> io_lock(this->io_mutex);
+			this->update_ready(0);
 		}
-		
 	}
 }
 
 
+EW Efunguz::start_io_thread(const long idle_timeout_ms) {
+	if (this->io_thread.joinable()) {
+		return EW::AlreadyStarted;
+	}
+
+	this->relaysock_io = zmq_socket(this->context, ZMQ_PAIR);
+	zmq_bind(this->relaysock_io, "inproc://relay");
+	this->relaysock_app = zmq_socket(this->context, ZMQ_PAIR);
+	zmq_connect(this->relaysock_app, "inproc://relay");
+#ifdef __linux__
+	zmqe_epoll_add(this->epoll_fd, this->relaysock_io, this->relaysock_io);
+#endif
+	this->update_relay();
+
+	for (auto& keyval : this->ehyphae) {
+		keyval.second.set_snapshotting(true);
+	}
+
+	this->emitsock = this->relaysock_app;
+	this->io_running = true;
+	this->io_thread = thread(&Efunguz::run_io, this, idle_timeout_ms); // sockets are handed over with memory barrier of thread start
+
+	return EW::Ok;
+}
+
+
+EW Efunguz::stop_io_thread() {
+	if (!this->io_thread.joinable()) {
+		return EW::AlreadyStopped;
+	}
+
+	this->io_running = false;
+	zmqe_send_copy(this->relaysock_app, nullptr, 0, false); // to wake I/O thread up at once
+	this->io_thread.join();
+
+	// Relay whatever has been emitted but not yet relayed
+	this->emitsock = this->pubsock;
+	this->update_relay();
+#ifdef __linux__
+	zmqe_epoll_del(this->epoll_fd, this->relaysock_io);
+#endif
+	zmq_close(this->relaysock_app);
+	zmq_close(this->relaysock_io);
+	this->relaysock_app = nullptr;
+	this->relaysock_io = nullptr;
+
+	for (auto& keyval : this->ehyphae) {
+		keyval.second.set_snapshotting(false);
+	}
+
+	return EW::Ok;
+}
+
+
 uint64_t Efunguz::in_attempted_num() {
 	return this->in_accepted_num;
 }
@@ -468,18 +3064,62 @@ uint64_t Efunguz::in_permitted_num() {
 }
 
 
+vector<InConnection> Efunguz::in_connections() {
+	lock_guard<mutex> connections_lock(this->in_connections_mutex);
+	return this->in_connections_open;
+}
+
+
+vector<InConnection> Efunguz::in_closed_connections() {
+	lock_guard<mutex> connections_lock(this->in_connections_mutex);
+	return vector<InConnection>(this->in_connections_closed.begin(), this->in_connections_closed.end());
+}
+
+
+void Efunguz::set_ehyphae_monitoring(const bool monitoring) {
+	lock_guard<mutex> io_lock(this->io_mutex);
+	this->ehyphae_monitoring = monitoring;
+	for (auto& keyval : this->ehyphae) {
+		Ehypha& ehypha = keyval.second;
+		if (monitoring && (ehypha.monsock == nullptr)) {
+			ehypha.start_monitor(this->context);
+#ifdef __linux__
+			zmqe_epoll_add(this->epoll_fd, ehypha.monsock, ehypha_mon_tag(&ehypha));
+			ehypha.update_mon();
+#endif
+		} else if (!monitoring && (ehypha.monsock != nullptr)) {
+#ifdef __linux__
+			zmqe_epoll_del(this->epoll_fd, ehypha.monsock);
+#endif
+			ehypha.stop_monitor();
+		}
+	}
+}
+
+
 uint64_t Efunguz::in_absorbing_num() {
 	return (this->in_accepted_num >= this->in_disconnected_num) ? (this->in_accepted_num - this->in_disconnected_num) : 0; // may temporarily exceed number of actually subscribed peers, until disconnection due to failed auth
 }
 
 
+uint64_t Efunguz::in_failed_num() {
+	return this->in_handshake_failed_num;
+}
+
+
 Efunguz::~Efunguz() {
+	this->stop_io_thread();
+
 	this->ehyphae.clear(); // to close subsock of each ehypha in its destructor before terminating context, to which those sockets belong
 
 	zmq_close(this->monsock);
 	zmq_close(this->pubsock);
 	zmq_close(this->zapsock);
 
+#ifdef __linux__
+	close(this->epoll_fd);
+#endif
+
 	zmq_ctx_shutdown(this->context);
 	while (zmq_ctx_term(this->context) == -1) {
 		if (zmq_errno() == EINTR) {
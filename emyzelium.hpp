@@ -40,9 +40,14 @@
 
 #include <zmq.h>
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <string>
+#include <thread>
 #include <unordered_set>
 #include <tuple>
 #include <vector>
@@ -57,13 +62,14 @@ namespace Emyzelium {
 namespace typeAliases {
 	using zcontext = void;
 	using zsocket = void;
+	using shared_part = shared_ptr<const vector<uint8_t>>;
 }
 
 using namespace typeAliases;
 
 
-const string LIB_VERSION = "0.9.10";
-const string LIB_DATE = "2024.02.02";
+const string LIB_VERSION = "0.9.12";
+const string LIB_DATE = "unreleased";
 
 enum class EW {
 	Ok 				= 0,
@@ -71,7 +77,10 @@ enum class EW {
 	AlreadyAbsent 	= 2,
 	AlreadyPaused 	= 3,
 	AlreadyResumed 	= 4,
-	Absent 			= 5
+	Absent 			= 5,
+	AlreadyStarted 	= 6,
+	AlreadyStopped 	= 7,
+	Unsupported 	= 8
 };
 
 const uint16_t DEF_PUBSUB_PORT = 0xEDAF; // 60847
@@ -79,46 +88,327 @@ const uint16_t DEF_PUBSUB_PORT = 0xEDAF; // 60847
 const uint16_t DEF_TOR_PROXY_PORT = 9050; // default from /etc/tor/torrc
 const string DEF_TOR_PROXY_HOST = "127.0.0.1";  // default from /etc/tor/torrc
 
+const long DEF_IO_IDLE_TIMEOUT_MS = 100;
+
+// Of parts of etale, marked per part in its time frame, see set_emit_compression() and set_emit_delta() of Efunguz
+enum class Ecodec : uint8_t {
+	Raw = 0,
+	Rle = 1, // run-length, for sparse data such as cells of zone
+	XorRle = 2 // run-length of XOR with same part of last keyframe
+};
+
+const size_t DEF_MIN_COMPRESSED_PART_LEN = 64;
+
+const size_t MAX_CHUNKED_ETALES_NUM = 2; // per title, being sent and waiting
+const size_t MAX_CHUNKS_BYTES_PER_UPDATE = 256 << 10; // w/o rate limit, beyond first chunk, so that etales emitted meanwhile go in between
+const size_t DEF_MAX_REASSEMBLED_LEN = size_t(256) << 20;
+
+const size_t LATENCY_BINS_NUM = 32;
+
+const size_t IN_CLOSED_CONNECTIONS_MAX_NUM = 256;
+
+
+// Snapshot of counters of received messages, of ehypha (all topics) or of etale (its topic)
+struct RecvStats {
+	uint64_t msgs_num; // incl. malformed, paused and unbased
+	uint64_t bytes_num; // of all frames, incl. topic and time
+	uint64_t malformed_num; // fewer than 2 frames, topic not terminated by 0, time frame neither of 8 bytes nor of 8 + codecs of parts, or part not decompressed
+	uint64_t paused_num; // arrived while etale was paused, thus ignored
+	uint64_t unbased_num; // deltas whose keyframe was not received, thus ignored until next keyframe
+	uint64_t replayed_num; // by last-value cache of publisher (see Efunguz::set_emit_cache()), applied only if newer than etale, not counted in latency_hist
+	uint64_t dropped_chunks_num; // of chunked etales not reassembled, since some chunk was lost (e.g. by queue limit), incl. ones collected before; in bytes_num, not in msgs_num
+	int64_t last_gap; // between last two arrivals, in microseconds, -1 if there were fewer
+	// Of t_in - t_out, in microseconds: 0th bin is < 1 (clocks of peers may differ), i-th is [2^(i-1), 2^i), last one has no upper bound
+	uint64_t latency_hist[LATENCY_BINS_NUM];
+};
+
+
+// Snapshot of counters of emitted etales of one topic
+struct EmitStats {
+	uint64_t msgs_num;
+	uint64_t bytes_num; // of parts
+	uint64_t packed_bytes_num; // of parts as emitted, i.e. after compression
+	uint64_t failed_num; // not emitted entirely, because queue to I/O thread was full
+};
+
+
+// Incoming connection to PUB socket of efunguz, as reported by its monitor
+struct InConnection {
+	int fd;
+	string peer_address; // "IP:port", empty for ipc
+	string publickey; // approved by ZAP auth, empty until handshake succeeds
+	int64_t t_accepted;
+	int64_t t_handshaken; // -1 until handshake succeeds
+	uint16_t handshake_failure; // ZMQ_EVENT_HANDSHAKE_FAILED_..., 0 if none
+	int64_t t_closed; // -1 while open
+};
+
+
+// Snapshot of outgoing connection of ehypha, as reported by monitor of its SUB socket
+struct OutStats {
+	bool connected; // handshake succeeded, and no disconnection since
+	uint64_t connected_num; // incl. those that failed handshake afterwards
+	uint64_t retried_num;
+	uint64_t handshake_failed_num;
+	uint64_t disconnected_num;
+	int64_t t_connected; // of last successful handshake, -1 if none
+	int64_t t_disconnected; // of last disconnection, -1 if none
+	int64_t retry_ivl_ms; // last reconnection interval, -1 if none
+};
+
+
+// Written by the thread that receives, readable from any thread
+struct RecvCounters;
+struct EmitCounters;
+struct EmitPacking;
+struct EmitChunks;
+struct EmitCache;
+struct CachedEtale;
+struct WarmSnapshot;
+struct SnapshotSlot;
+struct OutCounters;
+
+
+// Part of etale as received, i.e. ZeroMQ message frame, whose data is not copied out of it
+class Epart {
+	friend class Ehypha;
+	friend class Efunguz;
+
+	zmq_msg_t msg;
+
+	zmq_msg_t* zmsg();
+	explicit Epart(const size_t size); // data to be written via zmsg()
+
+public:
+	Epart();
+	Epart(const uint8_t* data, const size_t size);
+	// Copy shares data (refcounted by ZeroMQ) instead of duplicating it
+	Epart(const Epart& other);
+	Epart(Epart&& other);
+	Epart& operator=(const Epart& other);
+	Epart& operator=(Epart&& other);
+
+	const uint8_t* data() const;
+	size_t size() const;
+
+	~Epart();
+};
+
 
 class Etale {
 	friend class Ehypha;
+	friend class Efunguz;
 
 	bool paused;
+	vector<Epart> zparts;
+	mutable vector<vector<uint8_t>> parts_copy;
+	mutable bool parts_copied;
+	bool conflated; // updated by current drain of conflating ehypha, snapshot not yet published
+	vector<Epart> conflated_parts; // frames of its latest message, unpacked once drain ends, unless superseded before; empty if none
+	size_t conflated_bytes_num;
+	int64_t conflated_t_out;
+	bool conflated_replayed;
+	shared_ptr<SnapshotSlot> snapshots; // latest copy for readers in other threads, and spare ones, reused once readers release them
+	shared_ptr<RecvCounters> counters; // shared with snapshots
+	vector<Epart> keyframe_parts; // of delta-encoded etale, base of following deltas
+	int64_t keyframe_num; // -1 until 1st keyframe
+	vector<uint8_t> chunks; // of large etale being reassembled, see set_emit_chunking() of Efunguz
+	int64_t chunks_t_out;
+	uint32_t chunks_num; // 0 unless reassembling
+	uint32_t chunks_next_index;
+	size_t chunks_bytes_num; // of their frames, counted once etale is complete
+	string msg_title; // of latest message
 
 public:
 	Etale(const vector<vector<uint8_t>>& parts={}, const int64_t t_out=-1, const int64_t t_in=-1, const bool paused=false);
 
-	vector<vector<uint8_t>> parts;
+	// Views into received frames, without copying
+	const vector<Epart>& eparts() const;
+	// Copy of eparts(), made on first call after each update
+	const vector<vector<uint8_t>>& parts() const;
+
+	// Reads atomic counters without lock, so can be called from any thread, as long as etale (or its snapshot) exists
+	RecvStats stats() const;
+
+	// Title of latest message; of etale of prefix, entire title that starts with it, empty until 1st message
+	const string& title() const;
+
 	int64_t t_out;
 	int64_t t_in;
 };
 
 
+// Handle of etale within its ehypha, to skip lookup by title; stale after del_etale()
+struct EtaleId {
+	uint32_t index;
+	uint32_t generation;
+};
+
+
+// Etales of ehypha by title, in open-addressing hash table with linear probing, looked up by title bytes without constructing string.
+// Etales themselves never move, so references to them stay valid until deletion
+class Etable {
+	struct Entry {
+		string title;
+		uint32_t generation;
+		unique_ptr<Etale> etale; // nullptr while entry is free
+	};
+
+	vector<Entry> entries; // by index of EtaleId
+	vector<uint32_t> free_indices;
+	vector<uint32_t> slots; // EMPTY_SLOT, DELETED_SLOT, or SLOT_INDEX_BASE + index of entry; size is power of 2
+	size_t etales_num;
+	size_t used_slots_num; // incl. deleted
+
+	size_t find_slot(const char* title, const size_t title_len) const;
+	void rehash(const size_t slots_num);
+
+public:
+	Etable();
+
+	Etale* find(const char* title, const size_t title_len) const;
+	Etale* find(const string& title) const;
+	Etale* find(const EtaleId& id) const;
+	tuple<EtaleId, bool> find_id(const string& title) const;
+	// Adds new etale, unless present
+	tuple<Etale&, bool> emplace(const string& title);
+	bool erase(const string& title);
+
+	template <typename F> void for_each(F f) {
+		for (auto& entry : this->entries) {
+			if (entry.etale) {
+				f(entry.title, *entry.etale);
+			}
+		}
+	}
+};
+
+
+// Etales of ehypha by title prefix, in trie of bytes, so that the longest prefix of received title is found in one walk along it
+class Etrie {
+	struct Node {
+		vector<pair<uint8_t, uint32_t>> children; // byte and index of node, sorted by byte
+		unique_ptr<Etale> etale; // nullptr unless some prefix ends here
+	};
+
+	vector<Node> nodes; // 0th is root, i.e. of empty prefix
+	vector<uint32_t> free_indices;
+	size_t etales_num;
+
+	uint32_t child(const uint32_t index, const uint8_t byte) const; // UINT32_MAX if none
+	uint32_t find_node(const string& prefix) const; // same
+
+	template <typename F> void for_each_from(const uint32_t index, string& prefix, F& f) {
+		if (this->nodes[index].etale) {
+			f(prefix, *this->nodes[index].etale);
+		}
+		for (const auto& child : this->nodes[index].children) {
+			prefix.push_back(char(child.first));
+			this->for_each_from(child.second, prefix, f);
+			prefix.pop_back();
+		}
+	}
+
+public:
+	Etrie();
+
+	bool empty() const;
+	Etale* find(const string& prefix) const;
+	// Of the longest prefix of title, nullptr if none
+	Etale* find_longest(const char* title, const size_t title_len) const;
+	// Adds new etale, unless present
+	tuple<Etale&, bool> emplace(const string& prefix);
+	bool erase(const string& prefix);
+
+	template <typename F> void for_each(F f) {
+		string prefix;
+		this->for_each_from(0, prefix, f);
+	}
+};
+
+
 class Ehypha {
 	friend class Efunguz;
 	
+	string serverkey;
 	zsocket* subsock;
-	unordered_map<string, Etale> etales;
+	zsocket* monsock; // nullptr unless monitored
+	Etable etales;
+	Etrie prefix_etales;
+	vector<Epart> recv_parts; // reused by update()
+	vector<Etale*> conflated_etales; // same
+	mutex* io_mutex; // of Efunguz, guards socket and etales against its I/O thread
+	bool snapshotting;
+	bool conflating;
+	size_t max_reassembled_len;
+	shared_ptr<RecvCounters> counters;
+	shared_ptr<OutCounters> out_counters;
+	shared_ptr<WarmSnapshot> warm_snapshot; // of Efunguz::load_snapshot(), nullptr if none
 
 	void update();
+	bool unpack_parts(Etale& etale, bool& unbased); // of recv_parts, in place
+	void take_parts(Etale& etale, const int64_t t_out, const int64_t t_in); // from recv_parts
+	void supersede_conflated(Etale& etale, const int64_t t); // drops its conflated_parts, counting them
+	bool reassemble(Etale& etale, size_t& bytes_num, bool& malformed); // whether recv_parts became entire etale
+	void drop_chunks(Etale& etale, const uint64_t chunks_num, const size_t bytes_num);
+	void update_mon();
+	void start_monitor(zcontext* context);
+	void stop_monitor();
+	void publish_snapshot(Etale& etale);
+	void set_snapshotting(const bool snapshotting);
+	void set_warm_snapshot(const shared_ptr<WarmSnapshot>& warm_snapshot);
+	void warm_up(Etale& etale, const bool prefix, const string& title); // from warm snapshot, unless etale has been received
 
 public:
 	// Owns socket, so cannot be copied
 	Ehypha(const Ehypha&) = delete;
 	Ehypha& operator=(const Ehypha&) = delete;
 
-	Ehypha(zcontext* context, const string& secretkey, const string& publickey, const string& serverkey, const string& onion, const uint16_t pubsub_port, const uint16_t torproxy_port, const string& torproxy_host);
+	// Empty socks_proxy means direct connection
+	Ehypha(zcontext* context, mutex* io_mutex, const string& secretkey, const string& publickey, const string& serverkey, const string& endpoint, const string& socks_proxy, const bool monitored=false);
 
+	// Subscribes to exactly this title: "zone" does not receive "zone2"
 	tuple<const Etale&, EW> add_etale(const string& title);
+	// While I/O thread of Efunguz runs, etale itself is being updated by it, so use get_etale_snapshot() instead
 	tuple<const Etale*, EW> get_etale_ptr(const string& title);
+	// Snapshot is acquired lock-free, and refreshed only while I/O thread runs; its parts() are not for concurrent use, unlike eparts().
+	// Lookup of etale is not synchronized with add_etale(), del_etale() and their prefix counterparts, so call it from other threads only while these are not called
+	tuple<shared_ptr<const Etale>, EW> get_etale_snapshot(const string& title);
+	// Same by handle, without lookup by title, but with the same restriction
+	tuple<EtaleId, EW> get_etale_id(const string& title);
+	tuple<const Etale*, EW> get_etale_ptr(const EtaleId& id);
+	tuple<shared_ptr<const Etale>, EW> get_etale_snapshot(const EtaleId& id);
 	EW del_etale(const string& title);
 
+	// Subscribes to all titles that start with prefix ("" for all), filtered by publisher, so that others are not even sent.
+	// Etale of prefix receives messages under each such title that has neither etale of its own nor etale of longer prefix,
+	// all interleaved, see Etale::title(); titles emitted with delta encoding or chunking need etales of their own
+	tuple<const Etale&, EW> add_etale_prefix(const string& prefix);
+	tuple<const Etale*, EW> get_etale_prefix_ptr(const string& prefix);
+	tuple<shared_ptr<const Etale>, EW> get_etale_prefix_snapshot(const string& prefix);
+	EW del_etale_prefix(const string& prefix);
+
 	EW pause_etale(const string& title);
 	EW resume_etale(const string& title);
 
+	// Incl. etales of prefixes
 	void pause_etales();
 	void resume_etales();
 
+	// In conflating mode, each etale takes only the latest of messages queued for it, once per drain of them, and only that one is
+	// decompressed and delta-applied (keyframes still are, in order), so that catching up costs unpacking and snapshots by topics
+	// rather than by messages. Counters still count every message, superseded ones as wellformed, since they are not unpacked
+	void set_conflating(const bool conflating);
+
+	// Chunked etale (see Efunguz::set_emit_chunking()) that would be longer, when reassembled, is dropped and counted as malformed,
+	// so that peer cannot make us allocate arbitrarily much by announcing many chunks
+	void set_max_reassembled_len(const size_t max_len);
+
+	// Like Etale::stats(), but of all messages, incl. those whose topic is malformed or not among etales
+	RecvStats stats() const;
+	// Meaningful only while monitored, see Efunguz::set_ehyphae_monitoring()
+	OutStats out_stats() const;
+
 	~Ehypha();
 };
 
@@ -127,7 +417,7 @@ class Efunguz {
 	string secretkey;
 	string publickey;
 	unordered_set<string> whitelist_publickeys;
-	uint16_t pubsub_port;
+	vector<string> pubsub_endpoints;
 	uint16_t torproxy_port;
 	string torproxy_host;
 	unordered_map<string, Ehypha> ehyphae;
@@ -136,9 +426,68 @@ class Efunguz {
 	vector<uint8_t> zap_session_id;
 	zsocket* pubsock;
 	zsocket* monsock;
-	uint64_t in_accepted_num;
-	uint64_t in_handshake_succeeded_num;
-	uint64_t in_disconnected_num;
+	atomic<uint64_t> in_accepted_num;
+	atomic<uint64_t> in_handshake_succeeded_num;
+	atomic<uint64_t> in_disconnected_num;
+	atomic<uint64_t> in_handshake_failed_num;
+	vector<InConnection> in_connections_open; // in order of acceptance
+	deque<InConnection> in_connections_closed; // latest ones
+	deque<tuple<string, bool>> zap_verdicts; // publickey and whether approved, awaiting their handshake events
+	mutex in_connections_mutex;
+	bool ehyphae_monitoring;
+	int epoll_fd; // Linux only; elsewhere, all sockets are polled each time
+	zsocket* emitsock; // where emit_etale() sends to: pubsock itself or, while I/O thread runs, relaysock_app
+	zsocket* relaysock_app; // inproc PAIR pipe from application thread (lock-free queue of ZeroMQ)...
+	zsocket* relaysock_io; // ...to I/O thread, which relays its messages to pubsock
+	thread io_thread;
+	atomic<bool> io_running;
+	mutex io_mutex;
+	unordered_map<string, shared_ptr<EmitCounters>> emit_counters; // inserted only by emitting thread...
+	mutex emit_counters_mutex; // ...under this, which readers take
+	unordered_map<string, shared_ptr<EmitPacking>> emit_packings; // compression and delta encoding by title, accessed only by emitting thread
+	size_t emit_chunk_len; // 0 for no chunking; accessed only by emitting thread
+	deque<shared_ptr<EmitChunks>> emit_chunks_queue; // round-robin by title, drained by update()...
+	size_t emit_chunks_rate; // bytes per second, 0 for no limit
+	double emit_chunks_tokens; // of rate limit
+	int64_t t_emit_chunks_refill;
+	bool emit_chunks_refused; // by pubsock in last update_chunks()
+	mutex emit_chunks_mutex; // ...between emitting thread and I/O thread
+	shared_ptr<WarmSnapshot> warm_snapshot;
+	bool emit_caching; // accessed only by emitting thread
+	bool emit_cache_collecting; // frames of etale being emitted, as sent...
+	unique_ptr<CachedEtale> emit_cache_pending; // ...into this
+	unordered_map<string, shared_ptr<EmitCache>> emit_cache; // latest etales by title, written by emitting thread...
+	mutex emit_cache_mutex; // ...and replayed by thread that owns pubsock
+	unordered_map<string, uint64_t> title_subscriptions; // numbers of subscriptions to exact titles (w/o terminating zero byte)...
+	unordered_map<string, uint64_t> prefix_subscriptions; // ...and to other prefixes of topics, updated by thread that owns pubsock...
+	mutex subscriptions_mutex; // ...under this
+
+	tuple<Ehypha&, EW> add_ehypha_at(const string& serverkey, const string& endpoint, const string& socks_proxy);
+
+	bool emit_etale_head(const string& title, const int64_t t_out, const bool more, const vector<uint8_t>& time_tail={});
+	bool emit_etale_at(const string& title, const int64_t t_out, const vector<vector<uint8_t>>& parts);
+	bool emit_etale_at(const string& title, const int64_t t_out, const vector<shared_part>& parts);
+	EmitPacking* emit_packing_of(const string& title);
+	EmitPacking& emit_packing_at(const string& title);
+	bool emit_etale_packed(const string& title, const int64_t t_out, const vector<const vector<uint8_t>*>& parts, EmitPacking* packing);
+	bool emit_etale_chunked(const string& title, const int64_t t_out, const vector<uint8_t>& time_tail, const vector<const vector<uint8_t>*>& parts, shared_ptr<vector<uint8_t>>& spare); // spare for serialized etale
+	bool queue_chunks(const string& title, const int64_t t_out, const shared_part& etale, const size_t chunk_len, const bool replay);
+	bool emit_chunks_pending(const string& title);
+	bool emit_frame(zmq_msg_t* msg, const bool more); // to emitsock, collected for cache if caching
+	bool emit_frame_copy(const void* data, const size_t size, const bool more);
+	void cache_emit(const string& title, const int64_t t_out, const bool sent, const bool keyframe, const bool delta);
+	void count_emit(const string& title, const size_t bytes_num, const size_t packed_bytes_num, const bool sent);
+	void replay_cached(const string& title, const EmitCache& cache);
+
+	void update_zap();
+	void update_mon();
+	void update_mon_event(const uint16_t event_num, const uint32_t event_value);
+	void update_relay();
+	void update_subscriptions();
+	void update_chunks();
+	long chunks_timeout_ms(const long timeout_ms);
+	void update_ready(const long timeout_ms);
+	void run_io(const long idle_timeout_ms);
 
 public:
 	// Owns context and sockets, so cannot be copied
@@ -146,6 +495,9 @@ public:
 	Efunguz& operator=(const Efunguz&) = delete;
 
 	Efunguz(const string& secretkey, const unordered_set<string>& whitelist_publickeys=unordered_set<string>{}, const uint16_t pubsub_port=DEF_PUBSUB_PORT, const uint16_t torproxy_port=DEF_TOR_PROXY_PORT, const string& torproxy_host=DEF_TOR_PROXY_HOST);
+	// Binds PUB socket to given endpoints, e.g. "tcp://127.0.0.1:60847" or "ipc:///tmp/emyz-john", besides or instead of the one for Tor;
+	// "inproc://" ones are skipped, because ZeroMQ does not apply Curve security to them
+	Efunguz(const string& secretkey, const unordered_set<string>& whitelist_publickeys, const vector<string>& pubsub_endpoints, const uint16_t torproxy_port=DEF_TOR_PROXY_PORT, const string& torproxy_host=DEF_TOR_PROXY_HOST);
 
 	void add_whitelist_publickeys(const unordered_set<string>& publickeys);
 	void del_whitelist_publickeys(const unordered_set<string>& publickeys);
@@ -153,16 +505,90 @@ public:
 	void read_whitelist_publickeys(const string& filepath);
 
 	tuple<Ehypha&, EW> add_ehypha(const string& that_publickey, const string& onion, const uint16_t pubsub_port=DEF_PUBSUB_PORT);
+	// Connects without Tor, to "tcp://" or "ipc://" endpoint of other efunguz; Curve security is kept, so "inproc://" is Unsupported
+	tuple<Ehypha*, EW> add_ehypha_direct(const string& that_publickey, const string& endpoint);
 	tuple<Ehypha*, EW> get_ehypha_ptr(const string& that_publickey);
 	EW del_ehypha(const string& that_publickey);
 
-	void emit_etale(const string& title, const vector<vector<uint8_t>>& parts);
+	// Each emit_etale...() returns false if etale has not been emitted (queued, while I/O thread runs),
+	// which may happen only in nodrop mode or when queue to I/O thread is full
+
+	// Copies each part once, into the outgoing message
+	bool emit_etale(const string& title, const vector<vector<uint8_t>>& parts);
+	// Takes ownership of parts, large ones are sent without copying
+	bool emit_etale(const string& title, vector<vector<uint8_t>>&& parts);
+	// Shares parts with the caller, who must not modify them afterwards; each is released when sent
+	bool emit_etale(const string& title, const vector<shared_part>& parts);
+
+	// Batch of (title, parts) stamped by one common t_out and sent back-to-back
+	vector<bool> emit_etales(const vector<tuple<string, vector<vector<uint8_t>>>>& batch);
+	vector<bool> emit_etales(const vector<tuple<string, vector<shared_part>>>& batch);
+
+	// Limit of queue of each subscriber (ZMQ_SNDHWM, default 1000 etales, 0 for none), for subscribers connected afterwards
+	void set_emit_hwm(const int hwm);
+	// When queue of some subscriber is full, etale is not emitted at all and emit_etale...() returns false,
+	// instead of being silently dropped for that subscriber only (ZMQ_XPUB_NODROP). While I/O thread runs, refused etales are dropped by it
+	void set_emit_nodrop(const bool nodrop);
+	// Parts of etales of this title, at least min_part_len long, are compressed by codec (Ecodec::Raw for none), unless that would not shorten them.
+	// Receivers decompress them transparently, but receivers before 0.9.12 count such etales as malformed. Call from thread that emits
+	void set_emit_compression(const string& title, const Ecodec codec, const size_t min_part_len=DEF_MIN_COMPRESSED_PART_LEN);
+	// Each keyframe_interval-th etale of this title (0 for none) is keyframe, compressed as above, others are deltas: parts of the same length as in keyframe,
+	// and not shorter than min_part_len, are sent as Ecodec::XorRle, if that shortens them. Subscriber that missed keyframe (e.g. joined later) ignores deltas
+	// until next one, since PUB-SUB has no way back to ask for it. Receivers before 0.9.12 count all such etales as malformed. Call from thread that emits
+	void set_emit_delta(const string& title, const size_t keyframe_interval);
+	// Etales longer than chunk_len (0 for no chunking) are split into chunks of it, which update() (or I/O thread) sends round-robin by title,
+	// at most max_rate bytes per second (0 for no limit, then at most MAX_CHUNKS_BYTES_PER_UPDATE per update()), so that short etales
+	// emitted meanwhile are not stuck behind long ones;
+	// etales of the same title emitted meanwhile wait for those chunks, and emit_etale...() returns false if there are already
+	// MAX_CHUNKED_ETALES_NUM of them. Receivers apply reassembled etale at once; those before 0.9.12 count chunks as malformed.
+	// Call from thread that emits
+	void set_emit_chunking(const size_t chunk_len, const size_t max_rate=0);
+	// Latest etale of each title, and its keyframe if delta-encoded, is kept (sharing parts) and replayed on each new subscription to it,
+	// incl. by prefix, so that peers that join later need not wait for next emit. Replay reaches all subscribers of the title; those that
+	// already have that etale ignore it, but receivers before 0.9.12 take it as usual one. Call from thread that emits
+	void set_emit_cache(const bool caching);
+
+	// Per topic; while I/O thread runs, emitted means queued for it
+	unordered_map<string, EmitStats> emit_stats();
+
+	// Of all subscribers, to this title or to prefixes of it, as of last update(); e.g. when 0, etale of this title reaches no one,
+	// so it need not even be made. Subscriber that subscribed by both counts twice
+	uint64_t subscriptions_num(const string& title);
+
+	// Writes received etales of all ehyphae, incl. etales of prefixes, with their t_out and t_in, into file laid out for load_snapshot();
+	// the file is replaced at once, by renaming. Returns false if it cannot be written
+	bool save_snapshot(const string& filepath);
+	// Maps file of save_snapshot() into memory, so that etales of present and later added ehyphae that have not been received yet
+	// start with its parts (not copied out of it) and times; call after construction for warm start. Nothing is parsed at loading:
+	// each etale is looked up by binary search when added, and counters count only what is received. Returns false if file cannot be mapped
+	// or is not such snapshot
+	bool load_snapshot(const string& filepath);
 
 	void update();
+	// Blocks until something arrives or timeout_ms (-1 for infinity) expires, then updates only what has arrived
+	void wait_update(const long timeout_ms);
+	// For external event loop: when any of these becomes readable, call update(). In Linux, it is the single epoll fd
+	vector<int> get_fds();
+
+	// From now on, dedicated thread owns sockets, answers ZAP and receives etales at once, publishing their snapshots;
+	// emit_etale() only queues messages for it, update() and wait_update() do nothing.
+	// Idle timeout bounds delay of changes (e.g. new ehyphae) that have not woken it up
+	EW start_io_thread(const long idle_timeout_ms=DEF_IO_IDLE_TIMEOUT_MS);
+	EW stop_io_thread();
 
 	uint64_t in_attempted_num();
 	uint64_t in_permitted_num();
 	uint64_t in_absorbing_num();
+	uint64_t in_failed_num();
+
+	// Monitor event of handshake has no fd, so it is ascribed to the earliest connection still in handshake,
+	// and its publickey, to the earliest ZAP verdict; exact unless handshakes overlap
+	vector<InConnection> in_connections();
+	// Up to IN_CLOSED_CONNECTIONS_MAX_NUM latest ones, incl. those that failed handshake
+	vector<InConnection> in_closed_connections();
+
+	// Monitoring costs 2 more sockets (and fds) per ehypha, so it is off by default; applies to present and future ehyphae
+	void set_ehyphae_monitoring(const bool monitoring);
 
 	~Efunguz();
 };